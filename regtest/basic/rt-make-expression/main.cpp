@@ -0,0 +1,54 @@
+#include "plumed/tools/CompiledExpression.h"
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace PLMD;
+
+int main(){
+  std::vector<std::string> var(2); var[0]="x"; var[1]="y";
+  const char* expressions[]={
+    "exp(-x^2)*y", "x^2+2*x*y-y^-2", "sin(x)*cos(y)+tan(x*y)", "sqrt(x^2+y^2)", "log(x)*x^y",
+    "(1-(x/y)^6)/(1-(x/y)^12)", "atan(x)+acot(y)+asinh(x)+acosh(y+2)+atanh(x/3)",
+    "sec(x)+csc(y)+cot(x+y)+sinh(x)*cosh(y)+tanh(x)+coth(y)+sech(x)+csch(y)",
+    "asin(x/3)+acos(y/4)+asec(y+2)+acsc(x+2)+acoth(y+2)+asech(x/3)+acsch(y)",
+    "abs(x-y)+step(x-0.5)+erf(x*y)", "-x^2", "2^-x^2+pi*e+1_pi+sqrt2"
+  };
+  const unsigned npoints=100;
+  std::vector<double> points( 2*npoints );
+  for(unsigned i=0;i<npoints;++i){ points[2*i]=0.2+0.01*i; points[2*i+1]=1.7-0.005*i; }
+
+  FILE* fp=fopen("output","w");
+  for(unsigned e=0;e<sizeof(expressions)/sizeof(expressions[0]);++e){
+    CompiledExpression ce; ce.set( expressions[e], var, true );
+    fprintf(fp,"%s\n",ce.getExpression().c_str());
+    // Evaluate all the points at once
+    std::vector<double> outputs( 3*npoints );
+    ce.evaluate( npoints, &points[0], &outputs[0] );
+    bool batch_ok=true, deriv_ok=true;
+    for(unsigned i=0;i<npoints;++i){
+      // Compare with the evaluation of a single point
+      double single[3]; ce.evaluate( &points[2*i], single );
+      for(unsigned k=0;k<3;++k) if( single[k]!=outputs[3*i+k] ) batch_ok=false;
+      // Compare the derivatives with finite differences
+      for(unsigned k=0;k<2;++k){
+        double plus[2]={points[2*i],points[2*i+1]}, minus[2]={points[2*i],points[2*i+1]}, vplus[3], vminus[3];
+        const double h=1e-6; plus[k]+=h; minus[k]-=h;
+        ce.evaluate( plus, vplus ); ce.evaluate( minus, vminus );
+        if( std::fabs( (vplus[0]-vminus[0])/(2*h) - outputs[3*i+1+k] )>1e-6*(1+std::fabs(outputs[3*i+1+k])) ) deriv_ok=false;
+      }
+    }
+    for(unsigned i=0;i<npoints;i+=33) fprintf(fp,"  %10.6f %10.6f %10.6f\n",outputs[3*i],outputs[3*i+1],outputs[3*i+2]);
+    fprintf(fp,"  batch %s derivatives %s\n",(batch_ok?"ok":"wrong"),(deriv_ok?"ok":"wrong"));
+  }
+  // Non finite constants are not folded, and are computed as libmatheval would do
+  {
+    CompiledExpression ce; ce.set( "x*sqrt(0-1)+y*log(0)+sqrt(0-2)", var, true );
+    double v[3]; ce.evaluate( &points[0], v );
+    fprintf(fp,"%s\n",ce.getExpression().c_str());
+    fprintf(fp,"  non finite %s\n",( std::isnan(v[0]) && std::isnan(v[1]) && std::isinf(v[2]) && v[2]<0 ? "ok" : "wrong" ));
+  }
+  fclose(fp);
+  return 0;
+}
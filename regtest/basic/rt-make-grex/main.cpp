@@ -0,0 +1,98 @@
+#include "mpi.h"
+#include "plumed/wrapper/Plumed.h"
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include <string>
+
+using namespace PLMD;
+
+/*
+  Two replicas running on two processes each exchange their coordinates
+  through the GREX interface, as it is done by MD codes for Hamiltonian replica exchange.
+  The two replicas use different atoms so that each replica needs atoms
+  that are not used by its partner.
+*/
+
+int main(int argc,char**argv){
+  MPI_Init(&argc,&argv);
+  int rank,size;
+  MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+  MPI_Comm_size(MPI_COMM_WORLD,&size);
+
+  const int nrep=2;
+  int rep=rank/(size/nrep);
+  MPI_Comm intracomm,intercomm;
+  MPI_Comm_split(MPI_COMM_WORLD,rep,rank,&intracomm);
+  int intrarank;
+  MPI_Comm_rank(intracomm,&intrarank);
+  MPI_Comm_split(MPI_COMM_WORLD,(intrarank==0?0:MPI_UNDEFINED),rank,&intercomm);
+
+  int natoms=20;
+  std::vector<double> positions(3*natoms,0.0);
+  std::vector<double> masses(natoms,1.0);
+  std::vector<double> forces(3*natoms,0.0);
+  std::vector<double> box(9,0.0);
+  std::vector<double> virial(9,0.0);
+  box[0]=box[4]=box[8]=10.0;
+
+  Plumed* p=new Plumed;
+  p->cmd("GREX setMPIIntracomm",&intracomm);
+  if(intrarank==0) p->cmd("GREX setMPIIntercomm",&intercomm);
+  p->cmd("GREX init");
+  p->cmd("setMPIComm",&intracomm);
+  p->cmd("setNatoms",&natoms);
+  p->cmd("setMDEngine","regtest");
+  std::string file="test." + std::to_string(rep) + ".log";
+  p->cmd("setLogFile",file.c_str());
+  file="plumed." + std::to_string(rep) + ".dat";
+  p->cmd("setPlumedDat",file.c_str());
+  p->cmd("init");
+
+  FILE* fp=NULL;
+  if(intrarank==0){
+    file="deltabias." + std::to_string(rep);
+    fp=std::fopen(file.c_str(),"w");
+  }
+
+  for(int step=0;step<6;step++){
+    for(int i=0;i<natoms;i++) for(int k=0;k<3;k++)
+      positions[3*i+k]=5.0+3.0*std::sin(1.3*i+0.7*k+0.4*step+2.1*rep);
+    for(unsigned i=0;i<forces.size();i++) forces[i]=0.0;
+    for(unsigned i=0;i<virial.size();i++) virial[i]=0.0;
+    p->cmd("setStep",&step);
+    p->cmd("setPositions",&positions[0]);
+    p->cmd("setBox",&box[0]);
+    p->cmd("setForces",&forces[0]);
+    p->cmd("setVirial",&virial[0]);
+    p->cmd("setMasses",&masses[0]);
+    p->cmd("calc");
+
+    if(step%2==0){
+      int partner=1-rep;
+      p->cmd("GREX savePositions");
+      p->cmd("GREX setPartner",&partner);
+      p->cmd("GREX prepare");
+      p->cmd("GREX calculate");
+      p->cmd("GREX shareAllDeltaBias");
+      double local=0.0;
+      p->cmd("GREX getLocalDeltaBias",&local);
+      if(fp) std::fprintf(fp,"%d %12.6f",step,local);
+// the bias of all the replicas is only available on the root process of each replica
+      if(intrarank==0) for(int r=0;r<nrep;r++){
+        double d=0.0;
+        std::string key="GREX getDeltaBias " + std::to_string(r);
+        p->cmd(key.c_str(),&d);
+        std::fprintf(fp," %12.6f",d);
+      }
+      if(fp) std::fprintf(fp,"\n");
+    }
+  }
+
+  if(fp) std::fclose(fp);
+  delete p;
+  MPI_Comm_free(&intracomm);
+  if(intercomm!=MPI_COMM_NULL) MPI_Comm_free(&intercomm);
+  MPI_Finalize();
+  return 0;
+}
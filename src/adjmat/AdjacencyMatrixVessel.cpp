@@ -125,13 +125,14 @@ void AdjacencyMatrixVessel::retrieveAdjacencyLists( std::vector<unsigned>& nneig
 void AdjacencyMatrixVessel::retrieveEdgeList( unsigned& nedge, std::vector<std::pair<unsigned,unsigned> >& edge_list ){
   plumed_dbg_assert( undirectedGraph() ); nedge=0;
   std::vector<double> myvals( getNumberOfComponents() );
-  if( getNumberOfStoredValues()>edge_list.size() ) error("adjacency lists are not large enough, increase maxconnections");
 
   for(unsigned i=0;i<getNumberOfStoredValues();++i){
       // Check if atoms are connected 
       retrieveSequentialValue( i, false, myvals );
       if( myvals[0]<epsilon || myvals[1]<epsilon ) continue ;
 
+      // The list grows as required so its capacity is reused at later steps
+      if( nedge==edge_list.size() ) edge_list.resize( nedge+1 );
       getMatrixIndices( function->getPositionInFullTaskList(i), edge_list[nedge].first, edge_list[nedge].second );
       nedge++;
   }
@@ -58,7 +58,7 @@ public:
   void retrieveMatrix( DynamicList<unsigned>& myactive_elements, Matrix<double>& mymatrix );
 /// Get the neighbour list based on the adjacency matrix
   void retrieveAdjacencyLists( std::vector<unsigned>& nneigh, Matrix<unsigned>& adj_list );
-/// Retrieve the list of edges in the adjacency matrix/graph
+/// Retrieve the list of edges in the adjacency matrix/graph (the list is enlarged if it is not large enough)
   void retrieveEdgeList( unsigned& nedge, std::vector<std::pair<unsigned,unsigned> >& edge_list );
 ///
   void getMatrixIndices( const unsigned& code, unsigned& i, unsigned& j ) const ;
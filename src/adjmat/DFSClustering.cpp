@@ -23,16 +23,18 @@
 #include "AdjacencyMatrixVessel.h"
 #include "core/ActionRegister.h"
 
-#ifdef __PLUMED_HAS_BOOST_GRAPH
-#include <boost/graph/adjacency_list.hpp>    
-#include <boost/graph/connected_components.hpp> 
-#include <boost/graph/graph_utility.hpp>
-#endif
+#include "tools/OpenMP.h"
+#include <atomic>
 
 //+PLUMEDOC MATRIXF DFSCLUSTERING
 /*
 Find the connected components of the matrix using the DFS clustering algorithm.
 
+The connected components are found by merging the nodes at the ends of each edge of the graph in 
+a union-find data structure.  The edges are processed in parallel when PLUMED is run with OpenMP threads.
+The clusters are numbered in the same way as they would be numbered by a depth first search 
+that visits the nodes in order of increasing index.
+
 \par Examples 
 
 */
@@ -43,19 +45,16 @@ namespace adjmat {
 
 class DFSClustering : public ClusteringBase {
 private:
-#ifdef __PLUMED_HAS_BOOST_GRAPH
 /// The list of edges in the graph
   std::vector<std::pair<unsigned,unsigned> > edge_list;
-#else
-/// The number of neighbors each atom has
-  std::vector<unsigned> nneigh;
-/// The adjacency list
-  Matrix<unsigned> adj_list;
-/// The color that tells us whether a node has been visited
-  std::vector<unsigned> color;
-/// The recursive function at the heart of this method
-  int explore( const unsigned& index );
-#endif
+/// The parent of each node in the union-find forest
+  std::vector<std::atomic<unsigned> > parent;
+/// The number of the cluster whose root is each node
+  std::vector<int> root_cluster;
+/// Find the root of the tree that contains a node
+  unsigned findRoot( unsigned index );
+/// Merge the trees that contain two nodes
+  void merge( unsigned i, unsigned j );
 public:
 /// Create manual
   static void registerKeywords( Keywords& keys );
@@ -70,66 +69,65 @@ PLUMED_REGISTER_ACTION(DFSClustering,"DFSCLUSTERING")
 void DFSClustering::registerKeywords( Keywords& keys ){
   ClusteringBase::registerKeywords( keys );
   keys.add("compulsory","MAXCONNECT","0","maximum number of connections that can be formed by any given node in the graph. "
-                                         "By default this is set equal to zero and the number of connections is set equal to the number "
-                                         "of nodes.  You only really need to set this if you are working with a very large system and "
-                                         "memory is at a premium");
+                                         "This is only used to decide how much memory to reserve for the list of edges, which grows as needed. "
+                                         "By default this is set equal to zero and the memory is allocated at the first step.");
 }
 
 DFSClustering::DFSClustering(const ActionOptions&ao):
 Action(ao),
-ClusteringBase(ao)
+ClusteringBase(ao),
+parent(getNumberOfNodes()),
+root_cluster(getNumberOfNodes())
 {
    unsigned maxconnections; parse("MAXCONNECT",maxconnections);
-#ifdef __PLUMED_HAS_BOOST_GRAPH 
-   if( maxconnections>0 ) edge_list.resize( getNumberOfNodes()*maxconnections );
-   else edge_list.resize(0.5*getNumberOfNodes()*(getNumberOfNodes()-1));
-#else
-   nneigh.resize( getNumberOfNodes() ); color.resize(getNumberOfNodes());
-   if( maxconnections>0 ) adj_list.resize(getNumberOfNodes(),maxconnections);
-   else adj_list.resize(getNumberOfNodes(),getNumberOfNodes()); 
-#endif
+   edge_list.reserve( getNumberOfNodes()*maxconnections ); 
+}
+
+unsigned DFSClustering::findRoot( unsigned index ){
+   // Path halving: each node visited is linked to its grandparent.  Concurrent updates
+   // can only move a node closer to its root so the search is safe when run in parallel
+   while( true ){
+      unsigned p=parent[index].load(std::memory_order_relaxed);
+      if( p==index ) return index;
+      unsigned gp=parent[p].load(std::memory_order_relaxed);
+      if( gp!=p ) parent[index].compare_exchange_weak( p, gp, std::memory_order_relaxed );
+      index=gp;
+   }
+}
+
+void DFSClustering::merge( unsigned i, unsigned j ){
+   while( true ){
+      i=findRoot(i); j=findRoot(j);
+      if( i==j ) return;
+      // The root with the larger index is always attached to the one with the smaller index.  This prevents cycles 
+      // and ensures that the root of each tree is the node with the lowest index in the cluster
+      if( i<j ) std::swap(i,j);
+      unsigned expected=i;
+      if( parent[i].compare_exchange_strong( expected, j ) ) return;
+   }
 }
 
 void DFSClustering::performClustering(){
-#ifdef __PLUMED_HAS_BOOST_GRAPH
    // Get the list of edges
    unsigned nedges=0; getAdjacencyVessel()->retrieveEdgeList( nedges, edge_list );
 
-   // Build the graph using boost
-   boost::adjacency_list<boost::vecS,boost::vecS,boost::undirectedS> sg(&edge_list[0],&edge_list[nedges],getNumberOfNodes());
+   // Build the union-find forest
+   for(unsigned i=0;i<getNumberOfNodes();++i) parent[i].store( i, std::memory_order_relaxed );
+   unsigned nt=OpenMP::getNumThreads();
+   if( nt*10>nedges ) nt=nedges/10;
+   if( nt==0 ) nt=1;
+   #pragma omp parallel for num_threads(nt)
+   for(unsigned i=0;i<nedges;++i) merge( edge_list[i].first, edge_list[i].second );
 
-   // Find the connected components using boost (-1 here for compatibility with non-boost version)
-   number_of_cluster=boost::connected_components(sg,&which_cluster[0]) - 1;
-
-   // And work out the size of each cluster
-   for(unsigned i=0;i<which_cluster.size();++i) cluster_sizes[which_cluster[i]].first++; 
-#else
-   // Get the adjacency matrix
-   getAdjacencyVessel()->retrieveAdjacencyLists( nneigh, adj_list ); 
-
-   // Perform clustering
-   number_of_cluster=-1; color.assign(color.size(),0);
+   // Number the clusters in order of their lowest index node and work out their sizes
+   number_of_cluster=-1;
    for(unsigned i=0;i<getNumberOfNodes();++i){
-      if( color[i]==0 ){ number_of_cluster++; color[i]=explore(i); } 
+      unsigned root=findRoot(i);
+      if( root==i ){ number_of_cluster++; root_cluster[i]=number_of_cluster; }
+      which_cluster[i]=root_cluster[root];
+      cluster_sizes[which_cluster[i]].first++;
    }
-#endif
-}
-
-#ifndef __PLUMED_HAS_BOOST_GRAPH
-int DFSClustering::explore( const unsigned& index ){
-
-   color[index]=1;
-   for(unsigned i=0;i<nneigh[index];++i){
-       unsigned j=adj_list(index,i);
-       if( color[j]==0 ) color[j]=explore(j);
-   }
-
-   // Count the size of the cluster
-   cluster_sizes[number_of_cluster].first++;
-   which_cluster[index] = number_of_cluster;
-   return color[index];
 }
-#endif
 
 }
 }
@@ -25,9 +25,42 @@
 
 //+PLUMEDOC INTERNAL landmarkselection
 /*
-This is currently a filler page.  
-
-Just use LANDMARKS=ALL.  More complex versions will appear in later versions.
+The analysis of long trajectories can be made cheaper by only analyzing a subset of the frames, the landmarks.
+The method used to select the landmarks is given with the LANDMARKS keyword.  The following methods are available:
+
+<table align=center frame=void width=95%% cellpadding=5%%>
+<tr>
+<td> <b> Method </b> </td> <td> <b> Description </b> </td> <td> <b> Keywords </b> </td>
+</tr> <tr>
+<td> ALL </td> <td> All the frames are used (default) </td> <td> </td>
+</tr> <tr>
+<td> STRIDE </td> <td> N landmarks equally spaced in time are used </td> <td> {STRIDE N=\f$n\f$} </td>
+</tr> <tr>
+<td> FPS </td> <td> Farthest point sampling: the first landmark is the first frame and each new landmark is the frame
+that is farthest from the landmarks already selected </td> <td> {FPS N=\f$n\f$} </td>
+</tr> <tr>
+<td> STAGED </td> <td> \f$\sqrt{N n_\textrm{frames}}\f$ frames are selected with farthest point sampling and N of them
+are then chosen at random with a probability proportional to their voronoi weights, so that the landmarks are both
+well spread and representative of the sampled distribution </td> <td> {STAGED N=\f$n\f$ SEED=\f$s\f$} </td>
+</tr>
+</table>
+
+Farthest point sampling computes the distances between the frames on the fly, using MPI and OpenMP, and only requires
+the distances between each frame and the landmarks, so the full matrix of dissimilarities is never stored.
+
+Unless the NOVORONOI flag is used, each landmark is then given a weight equal to the sum of the weights of the frames
+that are closer to it than to any other landmark.  With the IGNORE_WEIGHTS flag the weights of the frames are ignored
+during landmark selection.  For example:
+
+\verbatim
+CLASSICAL_MDS ...
+  ARG=d1,d2,d3
+  USE_ALL_DATA
+  LANDMARKS={FPS N=50}
+  NLOW_DIM=2
+  OUTPUT_FILE=embed
+... CLASSICAL_MDS
+\endverbatim
 
 */
 //+ENDPLUMEDOC
@@ -23,6 +23,7 @@
 #include "ClassicalScaling.h"
 #include "reference/PointWiseMapping.h"
 #include "core/ActionRegister.h"
+#include "tools/OpenMP.h"
 
 namespace PLMD {
 namespace analysis {
@@ -65,6 +66,22 @@ CLASSICAL_MDS ...
 ... CLASSICAL_MDS
 \endverbatim
 
+When the trajectory is long the projection can be computed for a set of landmark frames only.  The
+remaining frames can then be projected out-of-sample by using the OUTPUT_ALL_FILE keyword.  In the following
+example 100 landmarks are selected using farthest point sampling (see \ref landmarkselection).
+
+\verbatim
+CLASSICAL_MDS ...
+  ATOMS=1-256
+  METRIC=OPTIMAL-FAST
+  USE_ALL_DATA
+  LANDMARKS={FPS N=100}
+  NLOW_DIM=2
+  OUTPUT_FILE=rmsd-embed
+  OUTPUT_ALL_FILE=rmsd-embed-all
+... CLASSICAL_MDS
+\endverbatim
+
 The following section is for people who are interested in how this method works in detail. A solid understanding of this material is 
 not necessary to use MDS.  
 
@@ -161,6 +178,20 @@ This derivation makes a number of assumptions about the how the low dimensional
 the stress. If you use an interative optimization algorithm such as SMACOF you may thus be able to find a better 
 (lower-stress) projection of the points.  For more details on the assumptions made 
 see <a href="http://quest4rigor.com/tag/multidimensional-scaling/"> this website.</a>
+
+\section dim-oos Out-of-sample projection
+
+When only a set of \f$M\f$ landmarks are used to build the projection, a frame \f$a\f$ that is not a landmark is
+projected using the squared distances, \f$\delta_{ai}\f$, between it and each of the landmarks:
+
+\f[
+x^a_k = -\frac{1}{2\lambda_k} \sum_{i=1}^M x^i_k \left( \delta_{ai} - \bar{\delta}_i \right)
+\qquad \textrm{with} \qquad \lambda_k = \sum_{i=1}^M (x^i_k)^2
+\f]
+
+where \f$\bar{\delta}_i\f$ is the mean of the squared distances between landmark \f$i\f$ and all the other landmarks.
+This is the triangulation used in landmark MDS (de Silva and Tenenbaum, Adv. Neural Inf. Proc. Sys. 15, 705 (2003)),
+which gives back the projections of the landmarks themselves.
 */
 //+ENDPLUMEDOC
 
@@ -169,6 +200,7 @@ private:
   unsigned nlow;
   std::string ofilename;
   std::string efilename;
+  std::string allfilename;
   PointWiseMapping* myembedding;
 public:
   static void registerKeywords( Keywords& keys );
@@ -184,6 +216,8 @@ void ClassicalMultiDimensionalScaling::registerKeywords( Keywords& keys ){
   keys.add("compulsory","NLOW_DIM","number of low-dimensional coordinates required");
   keys.add("compulsory","OUTPUT_FILE","file on which to output the final embedding coordinates");
   keys.add("compulsory","EMBEDDING_OFILE","dont output","file on which to output the embedding in plumed input format");
+  keys.add("compulsory","OUTPUT_ALL_FILE","dont output","file on which to output the projections of all the frames, including those "
+                                                        "that were not selected as landmarks, which are projected out-of-sample");
 }
 
 ClassicalMultiDimensionalScaling::ClassicalMultiDimensionalScaling( const ActionOptions& ao ):
@@ -205,6 +239,7 @@ AnalysisWithLandmarks(ao)
 
   parseOutputFile("EMBEDDING_OFILE",efilename);
   parseOutputFile("OUTPUT_FILE",ofilename);
+  parseOutputFile("OUTPUT_ALL_FILE",allfilename);
 }
 
 ClassicalMultiDimensionalScaling::~ClassicalMultiDimensionalScaling(){
@@ -242,6 +277,55 @@ void ClassicalMultiDimensionalScaling::analyzeLandmarks(){
      myembedding->print( "classical mds", getTime(), afile, getOutputFormat(), atoms.getUnits().getLength()/0.1 );
      afile.close();
   }
+
+  // Project all the frames out-of-sample
+  if( allfilename!="dont output"){
+     const unsigned nland=myembedding->getNumberOfReferenceFrames();
+     const unsigned nframes=getNumberOfDataPoints();
+     const Matrix<double>& dmat( myembedding->modifyDmat() );
+     std::vector<double> lambda( nlow, 0.0 ), mean( nland, 0.0 );
+     for(unsigned i=0;i<nland;++i){
+         for(unsigned k=0;k<nlow;++k) lambda[k]+=myembedding->getProjectionCoordinate(i,k)*myembedding->getProjectionCoordinate(i,k);
+         for(unsigned j=0;j<nland;++j) mean[i]+=dmat(i,j);
+         mean[i]/=nland;
+     }
+     for(unsigned k=0;k<nlow;++k){
+         if( lambda[k]==0 ) error("cannot project out-of-sample as embedding has a zero eigenvalue");
+     }
+
+     std::vector<double> proj( nframes*nlow, 0.0 );
+     const unsigned rank=comm.Get_rank(), size=comm.Get_size();
+     unsigned nt=OpenMP::getNumThreads();
+     if( nt*10>nframes/size ) nt=nframes/(10*size);
+     if( nt==0 ) nt=1;
+     #pragma omp parallel num_threads(nt)
+     {
+         std::vector<double> delta( nland );
+         #pragma omp for
+         for(unsigned a=rank;a<nframes;a+=size){
+             for(unsigned i=0;i<nland;++i) delta[i]=distance( getPbc(), getArguments(), data[a], myembedding->getFrame(i), true ) - mean[i];
+             for(unsigned k=0;k<nlow;++k){
+                 double xk=0;
+                 for(unsigned i=0;i<nland;++i) xk+=myembedding->getProjectionCoordinate(i,k)*delta[i];
+                 proj[a*nlow+k] = -0.5*xk/lambda[k];
+             }
+         }
+     }
+     comm.Sum( proj );
+
+     OFile pfile; pfile.link(*this);
+     pfile.setBackupString("analysis");
+     pfile.fmtField(getOutputFormat()+" ");
+     pfile.open( allfilename.c_str() );
+     for(unsigned a=0;a<nframes;++a){
+         for(unsigned k=0;k<nlow;++k){
+             std::string num; Tools::convert(k+1,num);
+             pfile.printField( getLabel() + "." + num , proj[a*nlow+k] );
+         }
+         pfile.printField();
+     }
+     pfile.close();
+  }
 }
 
 }
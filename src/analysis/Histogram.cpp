@@ -20,7 +20,6 @@
    along with plumed.  If not, see <http://www.gnu.org/licenses/>.
 +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 #include "core/ActionRegister.h"
-#include "tools/KernelFunctions.h"
 #include "gridtools/ActionWithGrid.h"
 #include "vesselbase/ActionWithVessel.h"
 #include "vesselbase/StoreDataVessel.h"
@@ -162,7 +161,9 @@ class Histogram : public gridtools::ActionWithGrid {
 private:
   double ww;
   bool in_apply, mvectors;
-  KernelFunctions* kernel;
+/// The center of the kernel that is evaluated on the grid, if any
+  bool haskernel;
+  std::vector<double> kernel_center;
   std::vector<double> forcesToApply, finalForces;
   std::vector<vesselbase::ActionWithVessel*> myvessels;
   std::vector<vesselbase::StoreDataVessel*> stashes;
@@ -173,7 +174,6 @@ public:
   unsigned getNumberOfQuantities() const ;
   void prepareForAveraging();
   void performOperations( const bool& from_update );
-  void finishAveraging();
   bool isPeriodic(){ return false; }
   unsigned getNumberOfDerivatives(); 
   void turnOnDerivatives();
@@ -200,7 +200,7 @@ ActionWithGrid(ao),
 ww(0.0),
 in_apply(false),
 mvectors(false),
-kernel(NULL)
+haskernel(false)
 {
   // Read in arguments 
   std::string vlab; parse("VECTORS",vlab);
@@ -356,10 +356,10 @@ void Histogram::prepareForAveraging(){
       else ww = cweight;  
   } else {
       // Now fetch the kernel and the active points
-      std::vector<double> point( getNumberOfArguments() );  
-      for(unsigned i=0;i<point.size();++i) point[i]=getArgument(i);
+      kernel_center.resize( getNumberOfArguments() );
+      for(unsigned i=0;i<kernel_center.size();++i) kernel_center[i]=getArgument(i);
       unsigned num_neigh; std::vector<unsigned> neighbors(1);
-      kernel = myhist->getKernelAndNeighbors( point, num_neigh, neighbors );
+      haskernel = myhist->getKernelAndNeighbors( kernel_center, num_neigh, neighbors );
 
       if( num_neigh>1 ){
           // Activate relevant tasks
@@ -375,10 +375,6 @@ void Histogram::prepareForAveraging(){
 
 void Histogram::performOperations( const bool& from_update ){ if( myvessels.size()==0 ) plumed_dbg_assert( !myhist->noDiscreteKernels() ); }
 
-void Histogram::finishAveraging(){
-  if( myvessels.size()==0 ) delete kernel;
-}
-
 void Histogram::compute( const unsigned& current, MultiValue& myvals ) const {  
   if( mvectors ){
       std::vector<double> cvals( myvessels[0]->getNumberOfQuantities() );
@@ -435,14 +431,12 @@ void Histogram::compute( const unsigned& current, MultiValue& myvals ) const {
       if( in_apply ) myvals.updateDynamicList();
   } else {
       plumed_assert( !in_apply );
-      std::vector<Value*> vv( myhist->getVectorOfValues() );
       std::vector<double> val( getNumberOfArguments() ), der( getNumberOfArguments() ); 
       // Retrieve the location of the grid point at which we are evaluating the kernel
       mygrid->getGridPointCoordinates( current, val );
-      if( kernel ){
-          for(unsigned i=0;i<getNumberOfArguments();++i) vv[i]->set( val[i] );
+      if( haskernel ){
           // Evaluate the histogram at the relevant grid point and set the values 
-          double vvh = kernel->evaluate( vv, der ,true); myvals.setValue( 1, vvh );
+          double vvh = myhist->evaluateKernel( kernel_center, val, der ); myvals.setValue( 1, vvh );
       } else {
           plumed_merror("normalisation of vectors does not work with arguments and spherical grids");
           // Evalulate dot product
@@ -453,7 +447,7 @@ void Histogram::compute( const unsigned& current, MultiValue& myvals ) const {
           for(unsigned j=0;j<getNumberOfArguments();++j) der[j] *= (myhist->von_misses_concentration)*newval;
       }
       // Set the derivatives and delete the vector of values
-      for(unsigned i=0;i<getNumberOfArguments();++i){ myvals.setDerivative( 1, i, der[i] ); delete vv[i]; }
+      for(unsigned i=0;i<getNumberOfArguments();++i) myvals.setDerivative( 1, i, der[i] );
   }
 }
 
@@ -21,6 +21,9 @@
 +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 #include "LandmarkSelectionBase.h"
 #include "reference/MultiReferenceBase.h"
+#include "tools/Communicator.h"
+#include "tools/OpenMP.h"
+#include <limits>
 
 namespace PLMD {
 namespace analysis {
@@ -34,7 +37,9 @@ action(myanalysis)
 LandmarkSelectionBase::LandmarkSelectionBase( const LandmarkSelectionOptions& lo ):
 style(lo.words[0]),
 input(lo.words),
-action(lo.action)
+action(lo.action),
+novoronoi(false),
+noweights(false)
 {
   input.erase( input.begin() );
   if( style=="ALL" ){
@@ -87,6 +92,48 @@ void LandmarkSelectionBase::selectFrame( const unsigned& iframe, MultiReferenceB
   myframes->copyFrame( action->data[iframe] );
 }
 
+void LandmarkSelectionBase::selectFarthestPoints( const unsigned& nsel, std::vector<unsigned>& selected, std::vector<unsigned>& closest ){
+  const unsigned nframes=getNumberOfFrames();
+  plumed_assert( nsel>0 && nsel<=nframes );
+  Communicator& comm( getCommunicator() );
+  const unsigned rank=comm.Get_rank(), size=comm.Get_size();
+  // Each process only keeps the distances of its own frames from the selected set
+  std::vector<unsigned> myframes;
+  for(unsigned i=rank;i<nframes;i+=size) myframes.push_back(i);
+  std::vector<double> mindist( myframes.size(), std::numeric_limits<double>::max() );
+  std::vector<unsigned> myclosest( myframes.size(), 0 );
+  unsigned nt=OpenMP::getNumThreads();
+  if( nt*10>myframes.size() ) nt=myframes.size()/10;
+  if( nt==0 ) nt=1;
+
+  selected.resize( nsel ); selected[0]=0;
+  std::vector<double> mymax(2), allmax(2*size);
+  for(unsigned k=0;k<nsel;++k){
+      const unsigned newframe=selected[k];
+      #pragma omp parallel for num_threads(nt)
+      for(unsigned i=0;i<myframes.size();++i){
+          const double d=getDistanceBetweenFrames( myframes[i], newframe );
+          if( d<mindist[i] ){ mindist[i]=d; myclosest[i]=k; }
+      }
+      if( k+1==nsel ) break;
+      // Find the frame that is farthest from the selected set
+      mymax[0]=-1.0; mymax[1]=0.0;
+      for(unsigned i=0;i<myframes.size();++i){
+          if( mindist[i]>mymax[0] ){ mymax[0]=mindist[i]; mymax[1]=myframes[i]; }
+      }
+      if( size>1 ) comm.Allgather( mymax, allmax );
+      else allmax=mymax;
+      unsigned best=0;
+      for(unsigned j=1;j<size;++j){
+          if( allmax[2*j]>allmax[2*best] || (allmax[2*j]==allmax[2*best] && allmax[2*j+1]<allmax[2*best+1]) ) best=j;
+      }
+      selected[k+1]=static_cast<unsigned>( allmax[2*best+1] );
+  }
+  closest.assign( nframes, 0 );
+  for(unsigned i=0;i<myframes.size();++i) closest[ myframes[i] ]=myclosest[i];
+  if( size>1 ) comm.Sum( closest );
+}
+
 void LandmarkSelectionBase::selectLandmarks( MultiReferenceBase* myframes ){
   // Select landmarks
   myframes->clearFrames(); select( myframes );
@@ -97,14 +144,24 @@ void LandmarkSelectionBase::selectLandmarks( MultiReferenceBase* myframes ){
       unsigned rank=action->comm.Get_rank();
       unsigned size=action->comm.Get_size();
       std::vector<double> weights( nlandmarks, 0.0 );
-      for(unsigned i=rank;i<action->data.size();i+=size){
-          unsigned closest=0;
-          double mindist=distance( action->getPbc(), action->getArguments(), action->data[i], myframes->getFrame(0), false );
-          for(unsigned j=1;j<nlandmarks;++j){
-              double dist=distance( action->getPbc(), action->getArguments(), action->data[i], myframes->getFrame(j), false );
-              if( dist<mindist ){ mindist=dist; closest=j; }
-          } 
-          weights[closest] += getWeightOfFrame(i);
+      unsigned nt=OpenMP::getNumThreads();
+      if( nt*10>action->data.size()/size ) nt=action->data.size()/(10*size);
+      if( nt==0 ) nt=1;
+      #pragma omp parallel num_threads(nt)
+      {
+          std::vector<double> omp_weights( nlandmarks, 0.0 );
+          #pragma omp for nowait
+          for(unsigned i=rank;i<action->data.size();i+=size){
+              unsigned closest=0;
+              double mindist=distance( action->getPbc(), action->getArguments(), action->data[i], myframes->getFrame(0), false );
+              for(unsigned j=1;j<nlandmarks;++j){
+                  double dist=distance( action->getPbc(), action->getArguments(), action->data[i], myframes->getFrame(j), false );
+                  if( dist<mindist ){ mindist=dist; closest=j; }
+              }
+              omp_weights[closest] += getWeightOfFrame(i);
+          }
+          #pragma omp critical
+          for(unsigned j=0;j<nlandmarks;++j) weights[j]+=omp_weights[j];
       }
       action->comm.Sum( &weights[0], weights.size() );
       myframes->setWeights( weights );
@@ -60,6 +60,9 @@ protected:
 /// Read a keywords from the input 
   template <class T>
   void parse(const std::string& ,T& );
+/// Read a keyword from the input if it is there
+  template <class T>
+  void parseOptional(const std::string& ,T& );
 /// Read a flag from the input
   void parseFlag(const std::string& key, bool& t);
 /// Get the number of frames in the underlying action
@@ -70,6 +73,10 @@ protected:
   double getDistanceBetweenFrames( const unsigned& , const unsigned&  );
 /// Transfer frame i in the underlying action to the object we are going to analyze
   void selectFrame( const unsigned& , MultiReferenceBase* );
+/// Select nsel frames using farthest point sampling starting from frame 0.
+/// The distances are computed on the fly, using MPI and OpenMP.
+/// On exit closest contains, for each frame, the position in selected of the closest selected frame
+  void selectFarthestPoints( const unsigned& nsel, std::vector<unsigned>& selected, std::vector<unsigned>& closest );
 public:
   explicit LandmarkSelectionBase( const LandmarkSelectionOptions& lo );
   virtual ~LandmarkSelectionBase();
@@ -105,6 +112,11 @@ void LandmarkSelectionBase::parse( const std::string& key, T& t ){
   if(!found) plumed_merror("landmark seleciton style " + style + " requires " + key + " keyword");
 }
 
+template <class T>
+void LandmarkSelectionBase::parseOptional( const std::string& key, T& t ){
+  Tools::parse(input,key,t);
+}
+
 }
 }
 #endif
@@ -26,6 +26,9 @@
 #include "reference/ReferenceConfiguration.h"
 #include "reference/ReferenceValuePack.h"
 #include "core/ActionRegister.h"
+#include "tools/Communicator.h"
+#include "tools/OpenMP.h"
+#include <cmath>
 
 //+PLUMEDOC DIMRED PCA
 /* 
@@ -86,6 +89,17 @@ d6: DISTANCE ATOMS=3,4
 PCA ARG=d1,d2,d3,d4,d5,d6 METRIC=EUCLIDEAN STRIDE=5 RUN=1000 NLOW_DIM=2 REWEIGHT_BIAS OFILE=pca-comp.pdb
 \endverbatim
 
+When the trajectory is very long storing all the frames may require too much memory.  If the STREAMING flag is used the
+frames are not stored.  The weighted average and covariance are instead updated every time a frame is collected (using the
+algorithm in D. H. D. West, Commun. ACM 22, 532 (1979)) so the memory needed does not depend on the length of the trajectory.
+When atomic positions are used each frame is aligned to the average structure that has been accumulated up to that point.
+The eigenvectors are output at the end of the simulation and, if OUTPUT_STRIDE is used, every OUTPUT_STRIDE steps.
+In the following example the eigenvectors are output every 10000 steps and the old output files are backed up.
+
+\verbatim
+PCA METRIC=OPTIMAL ATOMS=1-22 STRIDE=1 STREAMING OUTPUT_STRIDE=10000 NLOW_DIM=2 OFILE=pca-comp.pdb
+\endverbatim
+
 */
 //+ENDPLUMEDOC
 
@@ -102,10 +116,32 @@ private:
 /// The eigenvectors for the displacements in argument space
   Matrix<double> arg_eigv;
   std::string ofilename;
+/// Are we updating the average and the covariance on the fly
+  bool streaming;
+/// The frequency with which the eigenvectors are output when streaming
+  unsigned outstride;
+/// The sum of the weights, the log of the weight used to rescale them and the step of the last output
+  double wsum, maxlogweight;
+  long int lastoutput;
+/// The running average and the coordinates of the current frame
+  std::vector<double> average, current;
+/// The running covariance (only the upper triangle is updated)
+  Matrix<double> stream_covar;
+/// Storage for the alignment to the running average
+  MultiValue* pca_val;
+  ReferenceValuePack* pca_pack;
+/// Update the running average and covariance with the current frame
+  void updateStreaming();
+/// Set the reference configuration to the running average
+  void setReferenceToAverage();
+/// Diagonalize the covariance and output the eigenvectors
+  void outputEigenvectors( Matrix<double>& covar );
 public:
   static void registerKeywords( Keywords& keys );
   explicit PCA(const ActionOptions&ao);
   ~PCA();
+  void performOperations( const bool& from_update );
+  void runFinalJobs();
   void performAnalysis();
   void performTask( const unsigned& , const unsigned& , MultiValue& ) const { plumed_error(); }
 };
@@ -116,10 +152,20 @@ void PCA::registerKeywords( Keywords& keys ){
   Analysis::registerKeywords( keys );
   keys.add("compulsory","NLOW_DIM","number of PCA coordinates required");
   keys.add("compulsory","OFILE","the file on which to output the eigenvectors");
+  keys.addFlag("STREAMING",false,"update the average and the covariance every time a frame is collected instead of storing the frames");
+  keys.add("compulsory","OUTPUT_STRIDE","0","when STREAMING is used, the frequency with which to output the eigenvectors. "
+                                            "The default value of zero means that they are only output at the end of the simulation");
 }
 
 PCA::PCA(const ActionOptions&ao):
-PLUMED_ANALYSIS_INIT(ao)
+PLUMED_ANALYSIS_INIT(ao),
+streaming(false),
+outstride(0),
+wsum(0),
+maxlogweight(0),
+lastoutput(-1),
+pca_val(NULL),
+pca_pack(NULL)
 {
   // Setup reference configuration
   log.printf("  performing PCA analysis using %s metric \n", getMetricName().c_str() );
@@ -137,11 +183,108 @@ PLUMED_ANALYSIS_INIT(ao)
 
   // Read stuff for output file
   parseOutputFile("OFILE",ofilename); 
+
+  parseFlag("STREAMING",streaming);
+  if( streaming ){
+     if( getNumberOfDataPoints()>0 ) error("RUN cannot be used with STREAMING, use OUTPUT_STRIDE to output the eigenvectors during the simulation");
+     parse("OUTPUT_STRIDE",outstride);
+     if( outstride>0 ){
+        if( outstride%getStride()!=0 ) error("OUTPUT_STRIDE must be a multiple of STRIDE");
+        log.printf("  updating average and covariance on the fly and outputting eigenvectors every %u steps\n",outstride);
+     } else {
+        log.printf("  updating average and covariance on the fly and outputting eigenvectors at the end of the simulation\n");
+     }
+     unsigned nvals=getNumberOfArguments()+3*getNumberOfAtoms();
+     average.resize( nvals ); current.resize( nvals ); stream_covar.resize( nvals, nvals ); stream_covar=0;
+     if( getNumberOfAtoms()>0 ){
+        pca_val = new MultiValue( 1, getNumberOfArguments() + 3*getNumberOfAtoms() + 9 );
+        pca_pack = new ReferenceValuePack( getNumberOfArguments(), getNumberOfAtoms(), *pca_val );
+        for(unsigned i=0;i<getNumberOfAtoms();++i) pca_pack->setAtomIndex( i, i );
+     }
+  }
   checkRead();
 }
 
 PCA::~PCA(){
   delete myref;
+  delete pca_pack;
+  delete pca_val;
+}
+
+void PCA::performOperations( const bool& from_update ){
+  if( !streaming ){ Analysis::performOperations( from_update ); return; }
+  if( getStep()==0 ) return;
+  updateStreaming();
+  if( outstride>0 && getStep()%outstride==0 ){
+     Matrix<double> mycovar( stream_covar ); outputEigenvectors( mycovar );
+     lastoutput=getStep();
+  }
+}
+
+void PCA::runFinalJobs(){
+  if( !streaming ){ Analysis::runFinalJobs(); return; }
+  if( wsum==0 ) error("no data is available for analysis");
+  if( lastoutput==getStep() ) return;
+  Matrix<double> mycovar( stream_covar ); outputEigenvectors( mycovar );
+}
+
+void PCA::setReferenceToAverage(){
+  unsigned narg=getNumberOfArguments();
+  std::vector<double> sarg( average.begin(), average.begin()+narg );
+  std::vector<Vector> spos( getNumberOfAtoms() );
+  for(unsigned j=0;j<getNumberOfAtoms();++j){
+      for(unsigned k=0;k<3;++k) spos[j][k]=average[narg+3*j+k];
+  }
+  std::vector<double> empty( narg, 1.0 ); myref->setReferenceConfig( spos, sarg, empty );
+}
+
+void PCA::updateStreaming(){
+  unsigned narg=getNumberOfArguments(), nvals=average.size();
+  // The weights are stored relative to the largest one seen so far so that they do not overflow
+  if( wsum==0 ){
+     maxlogweight=lweight;
+  } else if( lweight>maxlogweight ){
+     double rescale=exp( maxlogweight - lweight ); wsum*=rescale;
+     for(unsigned j=0;j<nvals;++j){
+        for(unsigned k=j;k<nvals;++k) stream_covar(j,k)*=rescale;
+     }
+     maxlogweight=lweight;
+  }
+  double ww=exp( lweight - maxlogweight );
+
+  // Get the coordinates of the current frame
+  std::vector<double> args( narg );
+  for(unsigned j=0;j<narg;++j) current[j]=args[j]=getArgument(j);
+  if( getNumberOfAtoms()>0 ){
+     // The first frame is the reference to which the second one is aligned
+     if( wsum==0 ){
+        std::vector<double> empty( narg, 1.0 ); myref->setReferenceConfig( getPositions(), args, empty );
+        myref->setupPCAStorage( *pca_pack );
+     }
+     // Align the frame to the running average
+     myref->calc( getPositions(), getPbc(), getArguments(), args, *pca_pack, true );
+     for(unsigned j=0;j<getNumberOfAtoms();++j){
+        Vector pos = myref->getReferencePositions()[j] + pca_pack->getAtomsDisplacementVector()[j];
+        for(unsigned k=0;k<3;++k) current[narg+3*j+k]=pos[k];
+     }
+  }
+
+  // Update the average and the upper triangle of the weighted covariance
+  wsum += ww;
+  std::vector<double> delta( nvals );
+  for(unsigned j=0;j<nvals;++j){
+     delta[j] = current[j] - average[j];
+     average[j] += ( ww / wsum )*delta[j];
+  }
+  unsigned nt=OpenMP::getNumThreads();
+  if( nt*10>nvals ) nt=nvals/10;
+  if( nt==0 ) nt=1;
+  #pragma omp parallel for num_threads(nt) schedule(dynamic,8)
+  for(unsigned j=0;j<nvals;++j){
+     double wdelta = ww*delta[j];
+     for(unsigned k=j;k<nvals;++k) stream_covar(j,k) += wdelta*( current[k] - average[k] );
+  }
+  if( getNumberOfAtoms()>0 ) setReferenceToAverage();
 }
 
 void PCA::performAnalysis(){
@@ -205,6 +348,18 @@ void PCA::performAnalysis(){
   for(unsigned i=0;i<covar.nrows();++i){
       for(unsigned j=0;j<covar.ncols();++j) covar(i,j) *= inorm; 
   }
+  outputEigenvectors( covar );
+}
+
+void PCA::outputEigenvectors( Matrix<double>& covar ){
+  unsigned narg=getNumberOfArguments();
+  if( streaming ){
+     // Normalise and fill the lower triangle of the running covariance
+     setReferenceToAverage();
+     for(unsigned i=0;i<covar.nrows();++i){
+         for(unsigned j=i;j<covar.ncols();++j){ covar(i,j) /= wsum; covar(j,i)=covar(i,j); }
+     }
+  }
 
   // Diagonalise the covariance
   std::vector<double> eigval( getNumberOfArguments()+3*getNumberOfAtoms() );
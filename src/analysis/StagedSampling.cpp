@@ -0,0 +1,83 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2016 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#include "LandmarkSelectionBase.h"
+#include "LandmarkRegister.h"
+#include "tools/Random.h"
+#include <cmath>
+
+namespace PLMD {
+namespace analysis {
+
+class StagedSampling : public LandmarkSelectionBase {
+private:
+  int seed;
+public:
+  explicit StagedSampling( const LandmarkSelectionOptions& lo );
+  std::string rest_of_description();
+  void select( MultiReferenceBase* );
+};
+
+PLUMED_REGISTER_LANDMARKS(StagedSampling,"STAGED")
+
+StagedSampling::StagedSampling( const LandmarkSelectionOptions& lo ):
+LandmarkSelectionBase(lo),
+seed(1234)
+{
+  parseOptional("SEED",seed);
+}
+
+std::string StagedSampling::rest_of_description(){
+  std::string sd; Tools::convert(seed,sd);
+  return "landmarks are selected at random among farthest points, with probability given by their voronoi weights (seed "+sd+")";
+}
+
+void StagedSampling::select( MultiReferenceBase* myframes ){
+  const unsigned nframes=getNumberOfFrames(), nland=getNumberOfLandmarks();
+  if( nland>nframes ) plumed_merror("cannot select more landmarks than there are frames");
+  // First select sqrt(nland*nframes) points by farthest point sampling
+  unsigned nfps=static_cast<unsigned>( std::ceil( std::sqrt( static_cast<double>(nland)*nframes ) ) );
+  if( nfps>nframes ) nfps=nframes;
+  std::vector<unsigned> fps, closest;
+  selectFarthestPoints( nfps, fps, closest );
+  // Voronoi weights of the farthest points
+  std::vector<double> weights( nfps, 0.0 );
+  for(unsigned i=0;i<nframes;++i) weights[ closest[i] ] += getWeightOfFrame(i);
+  // Then pick the landmarks at random with probability proportional to the weights.
+  // This is done on all processes with the same seed, so that they all select the same frames
+  Random random; random.setSeed(-seed);
+  std::vector<bool> taken( nfps, false );
+  for(unsigned k=0;k<nland;++k){
+      double total=0.0; unsigned last=0;
+      for(unsigned i=0;i<nfps;++i) if( !taken[i] ){ total+=weights[i]; last=i; }
+      double r=random.RandU01()*total, sum=0.0; unsigned chosen=last;
+      for(unsigned i=0;i<nfps;++i){
+          if( taken[i] ) continue;
+          sum+=weights[i];
+          if( r<sum ){ chosen=i; break; }
+      }
+      taken[chosen]=true;
+      selectFrame( fps[chosen], myframes );
+  }
+}
+
+}
+}
@@ -35,6 +35,8 @@
 #include <iostream>
 #include <limits>
 #include <ctime>
+#include <thread>
+#include <cstdio>
 
 #define DP2CUTOFF 6.25
 
@@ -87,7 +89,11 @@ This default choice should be reasonable for most applications.
 
 Metadynamics can be restarted either from a HILLS file as well as from a GRID, in this second
 case one can first save a GRID using GRID_WFILE (and GRID_WSTRIDE) and at a later stage read
-it using GRID_RFILE.
+it using GRID_RFILE. With GRID_WBINARY the grid is written in a binary format, which is
+much faster to write and read for large grids and is recognized automatically by GRID_RFILE.
+With GRID_WASYNC a copy of the grid is written in a background thread while the simulation
+proceeds. In both cases the grid is first written on a temporary file which then replaces
+GRID_WFILE, so that a complete grid is always available on disk.
 
 Another option that is available in plumed is well-tempered metadynamics \cite Barducci:2008. In this
 varient of metadynamics the heights of the Gaussian hills are rescaled at each step so the bias is now
@@ -231,6 +237,55 @@ where all the walkers are located. WALKERS_RSTRIDE is the number of step between
 one update and the other. Since version 2.2.5, hills files are automatically
 flushed every WALKERS_RSTRIDE steps.
 
+\par
+When all the walkers run on the same node, they can share a single copy of the
+bias grid in POSIX shared memory, using the keyword WALKERS_SHM to provide
+the name of the shared memory segment. Each walker then only deposits its own hills,
+and does not need to read the hills deposited by the other walkers from their HILLS files.
+HILLS files are written as usual and can be used to restart the simulation.
+\verbatim
+DISTANCE ATOMS=3,5 LABEL=d1
+METAD ...
+   ARG=d1 SIGMA=0.05 HEIGHT=0.3 PACE=500 LABEL=restraint
+   GRID_MIN=0 GRID_MAX=3 GRID_BIN=300
+   WALKERS_N=10
+   WALKERS_ID=3
+   WALKERS_DIR=../
+   WALKERS_SHM=metad-walkers
+... METAD
+\endverbatim
+The segment is created by the first walker that starts, which also reads all the HILLS files
+when restarting, and is removed when the last walker terminates. Since a new segment does not
+contain the hills deposited in a previous run, a walker that creates it without RESTART
+stops with an error if it finds the HILLS file of another walker: a walker started after
+all the other ones have terminated should thus use RESTART.
+The name should be unique on the node. A segment left over by a crashed simulation is detected
+when starting a new one, and should then be removed (on Linux, by deleting the corresponding file in /dev/shm).
+WALKERS_SHM requires a non sparse grid and can only be used with a single MPI process per walker.
+
+\par
+When walkers are run as a single MPI job (e.g. with the --multi option of the driver or
+with GROMACS -multi) the hills can be shared with MPI using the flag WALKERS_MPI.
+In this case all the walkers exchange their hills in a single packed message
+each time a hill is deposited. With a large number of walkers this collective
+operation can become expensive, since every walker waits for the slowest one.
+The keyword WALKERS_MPI_BATCH can be used to pack the hills of several
+depositions in a single message, and the flag WALKERS_MPI_ASYNC
+can be used to overlap the exchange with the following MD step using
+nonblocking collective operations. In both cases the hills deposited by the present walker are
+added immediately, whereas those deposited by the other walkers are added
+when the exchange is completed (that is, at the step following the last
+deposition of a batch when WALKERS_MPI_ASYNC is used).
+Notice that hills belonging to an incomplete batch at the end of the simulation
+are not shared with the other walkers.
+\verbatim
+DISTANCE ATOMS=3,5 LABEL=d1
+METAD ...
+   ARG=d1 SIGMA=0.05 HEIGHT=0.3 PACE=500 LABEL=restraint
+   WALKERS_MPI WALKERS_MPI_BATCH=4 WALKERS_MPI_ASYNC
+... METAD
+\endverbatim
+
 \par
 The c(t) reweighting factor can be calculated on the fly using the equations
 presented in \cite Tiwary_jp504920s as described above.
@@ -334,6 +389,13 @@ private:
   Grid* BiasGrid_;
   bool storeOldGrids_;
   int wgridstride_; 
+// grid dumps can be written in binary format and/or in a background thread
+  bool wgridbinary_;
+  bool wgridasync_;
+  bool gridWriter_;
+  string gridpath_;
+  std::thread gridThread_;
+  string gridThreadError_;
   bool grid_;
   double height0_;
   double biasf_;
@@ -350,8 +412,21 @@ private:
   string mw_dir_;
   int mw_id_;
   int mw_rstride_;
+  string mw_shm_;
+  SharedGrid* sharedGrid_;
   bool walkers_mpi;
   unsigned mpi_nw_;
+  unsigned mpi_id_;
+// number of depositions exchanged among MPI walkers in a single message
+  unsigned mpi_batch_;
+  bool mpi_async_;
+  unsigned mpi_nbatched_;
+// packed hills waiting to be sent and hills currently being exchanged
+  vector<double> mpi_sendbuf_;
+  vector<double> mpi_inflight_;
+  vector<double> mpi_recvbuf_;
+  Communicator::Request mpi_request_;
+  bool mpi_pending_;
   bool acceleration;
   double acc;
   vector<IFile*> ifiles;
@@ -378,6 +453,11 @@ private:
   vector<unsigned> getGaussianSupport(const Gaussian&);
   bool   scanOneHill(IFile *ifile,  vector<Value> &v, vector<double> &center, vector<double>  &sigma, double &height, bool &multivariate);
   void   computeReweightingFactor();
+  void   packGaussian(const Gaussian&,vector<double>&);
+  void   startWalkersExchange();
+  void   finishWalkersExchange();
+  void   writeGridSnapshot();
+  void   waitGridSnapshot();
   string fmt;
 
 public:
@@ -425,15 +505,20 @@ void MetaD::registerKeywords(Keywords& keys){
   keys.add("optional","GRID_WFILE","the file on which to write the grid");
   keys.add("optional","GRID_RFILE","a grid file from which the bias should be read at the initial step of the simulation");
   keys.addFlag("STORE_GRIDS",false,"store all the grid files the calculation generates. They will be deleted if this keyword is not present");
+  keys.addFlag("GRID_WBINARY",false,"write the grid in binary format. Binary grids can be read back with GRID_RFILE");
+  keys.addFlag("GRID_WASYNC",false,"write the grid from a copy in a background thread, so that the simulation does not wait for the file to be written");
   keys.add("optional","ADAPTIVE","use a geometric (=GEOM) or diffusion (=DIFF) based hills width scheme. Sigma is one number that has distance units or timestep dimensions");
   keys.add("optional","WALKERS_ID", "walker id");
   keys.add("optional","WALKERS_N", "number of walkers");
   keys.add("optional","WALKERS_DIR", "shared directory with the hills files from all the walkers");
   keys.add("optional","WALKERS_RSTRIDE","stride for reading hills files");
+  keys.add("optional","WALKERS_SHM","name of a shared memory segment used to share the bias grid among the walkers running on the same node");
   keys.add("optional","INTERVAL","monodimensional lower and upper limits, outside the limits the system will not feel the biasing force.");
   keys.add("optional","SIGMA_MAX","the upper bounds for the sigmas (in CV units) when using adaptive hills. Negative number means no bounds ");
   keys.add("optional","SIGMA_MIN","the lower bounds for the sigmas (in CV units) when using adaptive hills. Negative number means no bounds ");
   keys.addFlag("WALKERS_MPI",false,"Switch on MPI version of multiple walkers - not compatible with WALKERS_* options other than WALKERS_DIR");
+  keys.add("optional","WALKERS_MPI_BATCH","with WALKERS_MPI, pack the hills of this number of depositions in a single message before sharing them with the other walkers");
+  keys.addFlag("WALKERS_MPI_ASYNC",false,"with WALKERS_MPI, share hills using nonblocking communication. Hills from the other walkers are added one step later");
   keys.addFlag("ACCELERATION",false,"Set to TRUE if you want to compute the metadynamics acceleration factor.");  
   keys.use("RESTART");
   keys.use("UPDATE_FROM");
@@ -441,11 +526,15 @@ void MetaD::registerKeywords(Keywords& keys){
 }
 
 MetaD::~MetaD(){
+  // do not leave a nonblocking exchange dangling
+  if(mpi_pending_ && mpi_async_ && comm.Get_rank()==0) mpi_request_.wait();
   if(flexbin) delete flexbin;
   if(BiasGrid_) delete BiasGrid_;
   if(TargetGrid_) delete TargetGrid_;
   hillsOfile_.close();
-  if(wgridstride_>0) gridfile_.close();
+  // the last snapshot must be completed before exiting
+  if(gridThread_.joinable()) gridThread_.join();
+  if(gridfile_.isOpen()) gridfile_.close();
   delete [] dp_;
   // close files
   for(int i=0;i<mw_n_;++i){
@@ -457,7 +546,7 @@ MetaD::~MetaD(){
 MetaD::MetaD(const ActionOptions& ao):
 PLUMED_BIAS_INIT(ao),
 // Grid stuff initialization
-BiasGrid_(NULL), wgridstride_(0), grid_(false),
+BiasGrid_(NULL), wgridstride_(0), wgridbinary_(false), wgridasync_(false), gridWriter_(false), grid_(false),
 // Metadynamics basic parameters
 height0_(std::numeric_limits<double>::max()), biasf_(1.0), dampfactor_(0.0), TargetGrid_(NULL),
 kbt_(0.0),
@@ -466,8 +555,9 @@ stride_(0), welltemp_(false),
 dp_(NULL), adaptive_(FlexibleBin::none),
 flexbin(NULL),
 // Multiple walkers initialization
-mw_n_(1), mw_dir_(""), mw_id_(0), mw_rstride_(1),
-walkers_mpi(false), mpi_nw_(0),
+mw_n_(1), mw_dir_(""), mw_id_(0), mw_rstride_(1), mw_shm_(""), sharedGrid_(NULL),
+walkers_mpi(false), mpi_nw_(0), mpi_id_(0),
+mpi_batch_(1), mpi_async_(false), mpi_nbatched_(0), mpi_pending_(false),
 acceleration(false), acc(0.0),
 // Interval initialization
 uppI_(-1), lowI_(-1), doInt_(false),
@@ -621,6 +711,10 @@ last_step_warn_grid(0)
   string gridfilename_;
   parse("GRID_WFILE",gridfilename_); 
   parseFlag("STORE_GRIDS",storeOldGrids_);
+  parseFlag("GRID_WBINARY",wgridbinary_);
+  parseFlag("GRID_WASYNC",wgridasync_);
+  if((wgridbinary_||wgridasync_) && wgridstride_==0) error("GRID_WBINARY and GRID_WASYNC require GRID_WSTRIDE");
+  if((wgridbinary_||wgridasync_) && storeOldGrids_) error("GRID_WBINARY and GRID_WASYNC are not compatible with STORE_GRIDS");
   if(grid_ && gridfilename_.length()>0){
     if(wgridstride_==0 ) error("frequency with which to output grid not specified use GRID_WSTRIDE");
   }
@@ -656,9 +750,20 @@ last_step_warn_grid(0)
   if(mw_n_<=mw_id_) error("walker ID should be a numerical value less than the total number of walkers");
   parse("WALKERS_DIR",mw_dir_);
   parse("WALKERS_RSTRIDE",mw_rstride_);
+  parse("WALKERS_SHM",mw_shm_);
+  if(mw_shm_.length()>0){
+    if(mw_n_<=1) error("WALKERS_SHM can only be used with WALKERS_N");
+    if(!grid_) error("WALKERS_SHM requires a grid");
+    if(sparsegrid) error("WALKERS_SHM is not compatible with GRID_SPARSE");
+    if(comm.Get_size()>1) error("WALKERS_SHM can only be used with a single MPI process per walker");
+  }
 
   // MPI version
   parseFlag("WALKERS_MPI",walkers_mpi);
+  parse("WALKERS_MPI_BATCH",mpi_batch_);
+  parseFlag("WALKERS_MPI_ASYNC",mpi_async_);
+  if(mpi_batch_<1) error("WALKERS_MPI_BATCH should be a positive integer");
+  if(!walkers_mpi && (mpi_batch_>1 || mpi_async_)) error("WALKERS_MPI_BATCH and WALKERS_MPI_ASYNC can only be used with WALKERS_MPI");
 
   // Inteval keyword
   vector<double> tmpI(2);
@@ -704,6 +809,8 @@ last_step_warn_grid(0)
     if(spline){log.printf("  Grid uses spline interpolation\n");}
     if(sparsegrid){log.printf("  Grid uses sparse grid\n");}
     if(wgridstride_>0){log.printf("  Grid is written on file %s with stride %d\n",gridfilename_.c_str(),wgridstride_);} 
+    if(wgridbinary_){log.printf("  Grid is written in binary format\n");}
+    if(wgridasync_){log.printf("  Grid is written in a background thread\n");}
   }
 
   if(mw_n_>1){
@@ -712,6 +819,7 @@ last_step_warn_grid(0)
     log.printf("  walker id %d\n",mw_id_);
     log.printf("  reading stride %d\n",mw_rstride_);
     if(mw_dir_!="")log.printf("  directory with hills files %s\n",mw_dir_.c_str());
+    if(mw_shm_.length()>0) log.printf("  bias grid shared among walkers in shared memory segment %s\n",mw_shm_.c_str());
   } else {
     if(walkers_mpi) {
       log.printf("  Multiple walkers active using MPI communnication\n"); 
@@ -719,10 +827,14 @@ last_step_warn_grid(0)
       if(comm.Get_rank()==0){
         // Only root of group can communicate with other walkers
         mpi_nw_=multi_sim_comm.Get_size();
+        mpi_id_=multi_sim_comm.Get_rank();
       }
       // Communicate to the other members of the same group
       // info abount number of walkers and walker index
       comm.Bcast(mpi_nw_,0);
+      comm.Bcast(mpi_id_,0);
+      if(mpi_batch_>1) log.printf("  hills are shared among walkers every %u depositions\n",mpi_batch_);
+      if(mpi_async_) log.printf("  hills are shared among walkers using nonblocking communication\n");
     }
   }
 
@@ -758,7 +870,8 @@ last_step_warn_grid(0)
      }
    }
    std::string funcl=getLabel() + ".bias";
-   if(!sparsegrid){BiasGrid_=new Grid(funcl,getArguments(),gmin,gmax,gbin,spline,true);}
+   if(mw_shm_.length()>0){BiasGrid_=sharedGrid_=new SharedGrid(funcl,getArguments(),gmin,gmax,gbin,spline,true,mw_shm_);}
+   else if(!sparsegrid){BiasGrid_=new Grid(funcl,getArguments(),gmin,gmax,gbin,spline,true);}
    else{BiasGrid_=new SparseGrid(funcl,getArguments(),gmin,gmax,gbin,spline,true);}
    std::vector<std::string> actualmin=BiasGrid_->getMin();
    std::vector<std::string> actualmax=BiasGrid_->getMax();
@@ -780,9 +893,29 @@ last_step_warn_grid(0)
       error("The GRID file you want to read: " + gridreadfilename_ + ", cannot be found!");
     }
     std::string funcl=getLabel() + ".bias";
-    BiasGrid_=Grid::create(funcl, getArguments(), gridfile, gmin, gmax, gbin, sparsegrid, spline, true);
-    gridfile.close();
-    if(BiasGrid_->getDimension()!=getNumberOfArguments()) error("mismatch between dimensionality of input grid and number of arguments");
+    Grid* readGrid;
+    if(Grid::isBinaryFile(gridfile.getPath())){
+      gridfile.close();
+      readGrid=Grid::createFromBinary(funcl, getArguments(), gridfile.getPath(), gmin, gmax, gbin, sparsegrid, spline, true);
+    } else {
+      readGrid=Grid::create(funcl, getArguments(), gridfile, gmin, gmax, gbin, sparsegrid, spline, true);
+      gridfile.close();
+    }
+    if(readGrid->getDimension()!=getNumberOfArguments()) error("mismatch between dimensionality of input grid and number of arguments");
+    if(sharedGrid_){
+      // only the walker that created the shared grid initializes it
+      if(sharedGrid_->isCreator()){
+        vector<double> der(getNumberOfArguments());
+        for(Grid::index_t i=0;i<readGrid->getSize();++i){
+          double f=readGrid->getValueAndDerivatives(i,der);
+          sharedGrid_->setValueAndDerivatives(i,f,der);
+        }
+      }
+      delete readGrid;
+    } else {
+      delete BiasGrid_;
+      BiasGrid_=readGrid;
+    }
     for(unsigned i=0;i<getNumberOfArguments();++i){
       if( getPntrToArgument(i)->isPeriodic()!=BiasGrid_->getIsPeriodic()[i] ) error("periodicity mismatch between arguments and input bias");
       double a, b;
@@ -807,15 +940,7 @@ last_step_warn_grid(0)
       double mesh=(b-a)/((double)gbin[i]);
       if(mesh>0.5*sigma0_[i]) log<<"  WARNING: Using a METAD with a Grid Spacing larger than half of the Gaussians width can produce artifacts\n";
     }
-    std::string funcl=getLabel() + ".bias";
-    if(!sparsegrid){BiasGrid_=new Grid(funcl,getArguments(),gmin,gmax,gbin,spline,true);}
-    else{BiasGrid_=new SparseGrid(funcl,getArguments(),gmin,gmax,gbin,spline,true);}
-    std::vector<std::string> actualmin=BiasGrid_->getMin();
-    std::vector<std::string> actualmax=BiasGrid_->getMax();
-    for(unsigned i=0;i<getNumberOfArguments();i++){
-      if(gmin[i]!=actualmin[i]) log<<"  WARNING: GRID_MIN["<<i<<"] has been adjusted to "<<actualmin[i]<<" to fit periodicity\n";
-      if(gmax[i]!=actualmax[i]) log<<"  WARNING: GRID_MAX["<<i<<"] has been adjusted to "<<actualmax[i]<<" to fit periodicity\n";
-    }
+    // the grid itself has been already allocated above
   }
 
   // creating vector of ifile* for hills reading 
@@ -844,8 +969,15 @@ last_step_warn_grid(0)
     ifiles.push_back(ifile);                                                             
     ifilesnames.push_back(fname);
     if(ifile->FileExist(fname)){
+      // a new shared grid does not contain the hills deposited by the other walkers in a previous run
+      if(sharedGrid_ && sharedGrid_->isCreator() && !getRestart() && i!=mw_id_){
+        delete BiasGrid_; BiasGrid_=sharedGrid_=NULL;
+        error("found hills file "+fname+" of another walker while creating shared memory segment "+mw_shm_+
+              ": use RESTART to continue the simulation or remove the file to start a new one");
+      }
       ifile->open(fname);
-      if(getRestart()&&!restartedFromGrid){
+      // with a shared grid, hills are read only by the walker that created it
+      if(getRestart()&&!restartedFromGrid&&(!sharedGrid_||sharedGrid_->isCreator())){
         log.printf("  Restarting from %s:",ifilesnames[i].c_str());                  
         readGaussians(ifiles[i]);                                                    
       }
@@ -855,6 +987,11 @@ last_step_warn_grid(0)
     }
   }
 
+  if(sharedGrid_){
+    if(sharedGrid_->isCreator()) sharedGrid_->setReady();
+    else sharedGrid_->waitReady();
+  }
+
   comm.Barrier();
   // this barrier is needed when using walkers_mpi
   // to be sure that all files have been read before
@@ -881,8 +1018,8 @@ last_step_warn_grid(0)
   // open grid file for writing
   if(wgridstride_>0){
     gridfile_.link(*this);
+    int r=0;
     if(walkers_mpi){
-      int r=0;
       if(comm.Get_rank()==0) r=multi_sim_comm.Get_rank();
       comm.Bcast(r,0);
       if(r>0) gridfilename_="/dev/null";
@@ -890,6 +1027,13 @@ last_step_warn_grid(0)
     }
     if(mw_n_>1) gridfile_.enforceSuffix("");
     gridfile_.open(gridfilename_);
+    if(wgridbinary_||wgridasync_){
+      // the file is only opened to take care of backups and suffixes,
+      // snapshots are then written on a temporary file and renamed onto it
+      gridpath_=gridfile_.getPath();
+      gridfile_.close();
+      gridWriter_=(comm.Get_rank()==0 && r==0);
+    }
   }
 
   // open hills file for writing
@@ -1306,6 +1450,104 @@ void MetaD::calculate()
   delete [] der;
 }
 
+void MetaD::packGaussian(const Gaussian& hill,vector<double>& buf){
+  // layout of a packed hill: multivariate, height, center, sigma
+  buf.push_back(hill.multivariate?1.0:0.0);
+  buf.push_back(hill.height);
+  buf.insert(buf.end(),hill.center.begin(),hill.center.end());
+  buf.insert(buf.end(),hill.sigma.begin(),hill.sigma.end());
+}
+
+void MetaD::startWalkersExchange(){
+  // the buffer being sent must stay untouched until the exchange is completed
+  mpi_inflight_.swap(mpi_sendbuf_);
+  mpi_sendbuf_.clear();
+  mpi_nbatched_=0;
+  mpi_recvbuf_.assign(mpi_nw_*mpi_inflight_.size(),0.0);
+  if(comm.Get_rank()==0){
+    // Communicate (only root)
+    if(mpi_async_) mpi_request_=multi_sim_comm.Iallgather(mpi_inflight_,mpi_recvbuf_);
+    else multi_sim_comm.Allgather(mpi_inflight_,mpi_recvbuf_);
+  }
+  mpi_pending_=true;
+  if(!mpi_async_) finishWalkersExchange();
+}
+
+void MetaD::finishWalkersExchange(){
+  if(comm.Get_rank()==0 && mpi_async_) mpi_request_.wait();
+  // Share info with group members
+  comm.Bcast(mpi_recvbuf_,0);
+  mpi_pending_=false;
+  const unsigned ncv=getNumberOfArguments();
+  const unsigned nsigma=(adaptive_!=FlexibleBin::none?ncv*(ncv+1)/2:ncv);
+  const unsigned nhills=mpi_inflight_.size()/(2+ncv+nsigma);
+  // own hills have been already added unless they are exchanged immediately
+  const bool skipown=(mpi_batch_>1 || mpi_async_);
+  vector<double> cv_now(ncv);
+  vector<double> sigma_now(nsigma);
+  for(unsigned i=0;i<mpi_nw_;i++){
+    if(skipown && i==mpi_id_) continue;
+    const double* p=&mpi_recvbuf_[i*mpi_inflight_.size()];
+    // actually add hills one by one
+    for(unsigned k=0;k<nhills;k++){
+      const bool multivariate=(p[0]>0.5);
+      const double height=p[1];
+      p+=2;
+      for(unsigned j=0;j<ncv;j++) cv_now[j]=p[j];
+      p+=ncv;
+      for(unsigned j=0;j<nsigma;j++) sigma_now[j]=p[j];
+      p+=nsigma;
+      Gaussian newhill=Gaussian(cv_now,sigma_now,height,multivariate);
+      addGaussian(newhill);
+      writeGaussian(newhill,hillsOfile_);
+    }
+  }
+}
+
+void MetaD::waitGridSnapshot(){
+  if(gridThread_.joinable()) gridThread_.join();
+  if(gridThreadError_.length()>0){
+    string msg=gridThreadError_;
+    gridThreadError_.clear();
+    error("error while writing grid: " + msg);
+  }
+}
+
+void MetaD::writeGridSnapshot(){
+  if(!gridWriter_) return;
+  // only one snapshot is written at a time
+  waitGridSnapshot();
+  Grid* snapshot=BiasGrid_->getDenseCopy();
+  string path=gridpath_;
+  string tmppath=path+".tmp";
+  bool binary=wgridbinary_;
+  auto write=[this,snapshot,path,tmppath,binary](){
+    try{
+      std::remove(tmppath.c_str());
+      if(binary) snapshot->writeBinary(tmppath);
+      else {
+        OFile ofile;
+        ofile.open(tmppath);
+        snapshot->writeToFile(ofile);
+        ofile.close();
+      }
+      // the complete file replaces the previous one at once
+      if(std::rename(tmppath.c_str(),path.c_str())!=0) plumed_merror("cannot rename " + tmppath + " into " + path);
+    } catch(std::exception& e){
+      // nothing can escape the thread, otherwise the whole simulation would be terminated
+      gridThreadError_=e.what();
+    } catch(...){
+      gridThreadError_="unknown exception";
+    }
+    delete snapshot;
+  };
+  if(wgridasync_) gridThread_=std::thread(write);
+  else {
+    write();
+    waitGridSnapshot();
+  }
+}
+
 void MetaD::update(){
   vector<double> cv(getNumberOfArguments());
   vector<double> thissigma;
@@ -1323,6 +1565,9 @@ void MetaD::update(){
 
   double vbias=getBiasAndDerivatives(cv);
 
+  // add the hills received from the other MPI walkers at the previous step
+  if(mpi_pending_) finishWalkersExchange();
+
   // if you use adaptive, call the FlexibleBin 
   if(adaptive_!=FlexibleBin::none){
     flexbin->update(nowAddAHill);
@@ -1341,33 +1586,15 @@ void MetaD::update(){
 
     // In case we use walkers_mpi, it is now necessary to communicate with other replicas.
     if(walkers_mpi){
-      // Allocate arrays to store all walkers hills
-      std::vector<double> all_cv(mpi_nw_*cv.size(),0.0);
-      std::vector<double> all_sigma(mpi_nw_*thissigma.size(),0.0);
-      std::vector<double> all_height(mpi_nw_,0.0);
-      std::vector<int>    all_multivariate(mpi_nw_,0);
-      if(comm.Get_rank()==0){
-        // Communicate (only root)
-        multi_sim_comm.Allgather(cv,all_cv);
-        multi_sim_comm.Allgather(thissigma,all_sigma);
-        multi_sim_comm.Allgather(height,all_height);
-        multi_sim_comm.Allgather(int(multivariate),all_multivariate);
-      }
-      // Share info with group members
-      comm.Bcast(all_cv,0);
-      comm.Bcast(all_sigma,0);
-      comm.Bcast(all_height,0);
-      comm.Bcast(all_multivariate,0);
-      for(unsigned i=0;i<mpi_nw_;i++){
-        // actually add hills one by one
-        std::vector<double> cv_now(cv.size());
-        std::vector<double> sigma_now(thissigma.size());
-        for(unsigned j=0;j<cv.size();j++) cv_now[j]=all_cv[i*cv.size()+j];
-        for(unsigned j=0;j<thissigma.size();j++) sigma_now[j]=all_sigma[i*thissigma.size()+j];
-        Gaussian newhill=Gaussian(cv_now,sigma_now,all_height[i],all_multivariate[i]);
+      Gaussian newhill=Gaussian(cv,thissigma,height,multivariate);
+      packGaussian(newhill,mpi_sendbuf_);
+      mpi_nbatched_++;
+      // when hills are shared in batches or asynchronously, own hills are added immediately
+      if(mpi_batch_>1 || mpi_async_){
         addGaussian(newhill);
         writeGaussian(newhill,hillsOfile_);
       }
+      if(mpi_nbatched_==mpi_batch_) startWalkersExchange();
     } else {
       Gaussian newhill=Gaussian(cv,thissigma,height,multivariate);
       addGaussian(newhill);
@@ -1386,7 +1613,9 @@ void MetaD::update(){
   work_+=vbias1-vbias;
 
   // dump grid on file
-  if(wgridstride_>0&&(getStep()%wgridstride_==0||getCPT())){
+  if(wgridstride_>0&&(getStep()%wgridstride_==0||getCPT())&&(wgridbinary_||wgridasync_)){
+    writeGridSnapshot();
+  } else if(wgridstride_>0&&(getStep()%wgridstride_==0||getCPT())){
     // in case old grids are stored, a sequence of grids should appear
     // this call results in a repetition of the header:
     if(storeOldGrids_) gridfile_.clearFields();
@@ -1411,7 +1640,8 @@ void MetaD::update(){
   }
 
   // if multiple walkers and time to read Gaussians
-  if(mw_n_>1 && getStep()%mw_rstride_==0){
+  // (not needed with a shared grid, since the other walkers deposit directly on it)
+  if(mw_n_>1 && !sharedGrid_ && getStep()%mw_rstride_==0){
     for(int i=0;i<mw_n_;++i){
       // don't read your own Gaussians
       if(i==mw_id_) continue;
@@ -24,6 +24,7 @@
 #include "core/PlumedMain.h"
 #include "core/Atoms.h"
 #include "core/Value.h"
+#include <algorithm>
 #include <cmath>
 #include <ctime>
 
@@ -142,11 +143,21 @@ class Metainference : public Bias
   Value* valueAccept;
   vector<Value*> valueSigma;
 
+  // contiguous copies used in the MC sampling
+  vector<double> mcargs_;
+  vector<double> mcdev2_;
+  // proposed and accepted scale at each MC step of the first replica
+  vector<double> mcscale_;
+  // requests for the nonblocking broadcasts of mcscale_
+  vector<Communicator::Request> mcreqs_;
+
   unsigned nrep_;
   unsigned replica_;
 
-  double getEnergySPE(const vector<double> &sigma, const double scale);
-  double getEnergyGJE(const vector<double> &sigma, const double scale);
+  void   getSquaredDeviations(const double scale, vector<double> &dev2);
+  double getEnergySPE(const vector<double> &sigma, const vector<double> &dev2);
+  double getEnergyGJE(const vector<double> &sigma, const vector<double> &dev2);
+  double getEnergy(const vector<double> &sigma, const vector<double> &dev2);
   void   doMonteCarlo();
   double getEnergyForceSPE();
   double getEnergyForceGJE();
@@ -343,54 +354,101 @@ MCfirst_(-1)
   log<<"  Bibliography "<<plumed.cite("Bonomi, Camilloni, Cavalli, Vendruscolo, Sci. Adv. 2, e150117 (2016)");
 }
 
-double Metainference::getEnergySPE(const vector<double> &sigma, const double scale){
+void Metainference::getSquaredDeviations(const double scale, vector<double> &dev2){
+  const unsigned narg=mcargs_.size();
+  for(unsigned i=0;i<narg;++i){
+    const double dev = scale*mcargs_[i]-parameters[i];
+    dev2[i] = dev*dev;
+  }
+}
+
+double Metainference::getEnergySPE(const vector<double> &sigma, const vector<double> &dev2){
   // calculate effective sigma
   const double smean2 = sigma_mean_*sigma_mean_;
   const double s = sqrt( sigma[0]*sigma[0] + smean2 );
-  // cycle on arguments
+  const double s2 = s*s;
+  // cycle on arguments: the terms are multiplied together and the
+  // logarithm is only taken when the product leaves a safe range
   double ene = 0.0;
-  for(unsigned i=0;i<getNumberOfArguments();++i){
-    const double dev = scale*getArgument(i)-parameters[i]; 
+  double prod = 1.0;
+  for(unsigned i=0;i<dev2.size();++i){
     // argument
-    const double a2 = 0.5*dev*dev + s*s;
-    // increment energy
-    ene += std::log( 2.0 * a2 / ( 1.0 - exp(- a2 / smean2) ) );
+    const double a2 = 0.5*dev2[i] + s2;
+    prod *= 2.0 * a2 / ( 1.0 - exp(- a2 / smean2) );
+    if(prod>1.e100 || prod<1.e-100) { ene += std::log(prod); prod = 1.0; }
   }
+  ene += std::log(prod);
   // add normalization and Jeffrey's prior
   ene += std::log(s) - static_cast<double>(ndata_)*std::log(sqrt2_div_pi*s);
   return kbt_ * ene;
 }
 
-double Metainference::getEnergyGJE(const vector<double> &sigma, const double scale){
-  // cycle on arguments
-  double ene = 0.0;
+double Metainference::getEnergyGJE(const vector<double> &sigma, const vector<double> &dev2){
   const double smean2 = sigma_mean_*sigma_mean_;
-  double ss = sigma[0]*sigma[0] + smean2; 
-  for(unsigned i=0;i<getNumberOfArguments();++i){
-    if(noise_type_==MGAUSS){ 
-      ss = sigma[i]*sigma[i] + smean2;
-      // add Jeffrey's prior - one per sigma
-      ene += 0.5*std::log(ss);
+  const unsigned narg = dev2.size();
+  double ene = 0.0;
+  if(noise_type_==MGAUSS){
+    // Jeffrey's prior (one per sigma) and normalization give log(ss) plus a constant for each datum
+    double prod = 1.0;
+    for(unsigned i=0;i<narg;++i){
+      const double ss = sigma[i]*sigma[i] + smean2;
+      ene += 0.5*dev2[i]/ss;
+      prod *= ss;
+      if(prod>1.e100 || prod<1.e-100) { ene += std::log(prod); prod = 1.0; }
     }
-    const double dev = scale*getArgument(i)-parameters[i]; 
-    ene += 0.5*dev*dev/ss + 0.5*std::log(ss*sqrt2_pi);
+    ene += std::log(prod) + 0.5*static_cast<double>(narg)*std::log(sqrt2_pi);
+  } else {
+    // with a single sigma only the sum of the squared deviations is needed
+    const double ss = sigma[0]*sigma[0] + smean2;
+    double dev2sum = 0.0;
+    for(unsigned i=0;i<narg;++i) dev2sum += dev2[i];
+    ene = 0.5*dev2sum/ss + 0.5*static_cast<double>(narg)*std::log(ss*sqrt2_pi);
+    // add Jeffrey's prior in case one sigma for all data points
+    ene += 0.5*std::log(ss);
   }
-  // add Jeffrey's prior in case one sigma for all data points
-  if(noise_type_==GAUSS) ene += 0.5*std::log(ss);
   return kbt_ * ene;
 }
 
-void Metainference::doMonteCarlo(){
-  double old_energy;
+double Metainference::getEnergy(const vector<double> &sigma, const vector<double> &dev2){
+  double ene = 0.0;
   switch(noise_type_) {
     case GAUSS:
     case MGAUSS:
-      old_energy = getEnergyGJE(sigma_,scale_);
+      ene = getEnergyGJE(sigma,dev2);
       break;
     case OUTLIERS:
-      old_energy = getEnergySPE(sigma_,scale_);
+      ene = getEnergySPE(sigma,dev2);
       break;
   }
+  return ene;
+}
+
+void Metainference::doMonteCarlo(){
+  // the arguments are copied once, the deviations are only
+  // computed again at each MC step when the scale is sampled
+  const unsigned narg=getNumberOfArguments();
+  mcargs_.resize(narg);
+  mcdev2_.resize(narg);
+  for(unsigned i=0;i<narg;++i) mcargs_[i]=getArgument(i);
+  getSquaredDeviations(scale_,mcdev2_);
+  double old_energy = getEnergy(sigma_,mcdev2_);
+
+  // the scaling factor should be the same for all the replicas: the first replica
+  // broadcasts the proposed and accepted values of the MC steps in (at most) 8 blocks.
+  // The broadcasts are nonblocking, so that the first replica does not wait for the
+  // others, and the others only lag behind by one block and propose their sigma
+  // moves while the scale is on its way
+  const bool share = doscale_ && nrep_>1;
+  const bool root = comm.Get_rank()==0;
+  const unsigned blocklen = (MCsteps_+7)/8;
+  if(doscale_) mcscale_.resize(2*MCsteps_);
+  mcreqs_.resize(0);
+  if(share && root && replica_!=0) {
+    for(unsigned i=0;i<MCsteps_;i+=blocklen)
+      mcreqs_.push_back(multi_sim_comm.Ibcast(&mcscale_[2*i],2*std::min(blocklen,MCsteps_-i),0));
+  }
+
+  vector<double> new_sigma(sigma_.size());
  
   // cycle on MC steps 
   for(unsigned i=0;i<MCsteps_;++i){
@@ -404,13 +462,9 @@ void Metainference::doMonteCarlo(){
       // check boundaries
       if(new_scale > scale_max_){new_scale = 2.0 * scale_max_ - new_scale;}
       if(new_scale < scale_min_){new_scale = 2.0 * scale_min_ - new_scale;}
-      // the scaling factor should be the same for all the replicas
-      if(comm.Get_rank()==0) multi_sim_comm.Bcast(new_scale,0);
-      comm.Bcast(new_scale,0);
     }
   
     // propose move for sigma
-    vector<double> new_sigma(sigma_.size());
     for(unsigned j=0;j<sigma_.size();j++) {
       const double r2 = static_cast<double>(rand()) / RAND_MAX;
       const double ds2 = -Dsigma_ + r2 * 2.0 * Dsigma_;
@@ -419,18 +473,21 @@ void Metainference::doMonteCarlo(){
       if(new_sigma[j] > sigma_max_){new_sigma[j] = 2.0 * sigma_max_ - new_sigma[j];}
       if(new_sigma[j] < sigma_min_){new_sigma[j] = 2.0 * sigma_min_ - new_sigma[j];}
     }
+
+    if(doscale_) {
+      // the move proposed by the first replica is used
+      if(share && replica_!=0) {
+        if(i%blocklen==0) {
+          if(root) mcreqs_[i/blocklen].wait();
+          comm.Bcast(&mcscale_[2*i],2*std::min(blocklen,MCsteps_-i),0);
+        }
+        new_scale=mcscale_[2*i];
+      }
+      getSquaredDeviations(new_scale,mcdev2_);
+    }
  
     // calculate new energy
-    double new_energy=0;
-    switch(noise_type_) {
-      case GAUSS:
-      case MGAUSS:
-        new_energy = getEnergyGJE(new_sigma,new_scale);
-        break;
-      case OUTLIERS:
-        new_energy = getEnergySPE(new_sigma,new_scale);
-        break;
-    }
+    const double new_energy = getEnergy(new_sigma,mcdev2_);
     // accept or reject
     const double delta = ( new_energy - old_energy ) / kbt_;
     // if delta is negative always accept move
@@ -450,12 +507,20 @@ void Metainference::doMonteCarlo(){
       }
     }
  
-    if(doscale_) {
-      // the scaling factor should be the same for all the replicas
-      if(comm.Get_rank()==0) multi_sim_comm.Bcast(scale_,0);
-      comm.Bcast(scale_,0);
+    if(share) {
+      // the scale accepted by the first replica is used
+      if(replica_==0) {
+        mcscale_[2*i]=new_scale;
+        mcscale_[2*i+1]=scale_;
+        if(root && ((i+1)%blocklen==0 || i+1==MCsteps_)) {
+          const unsigned first=i-i%blocklen;
+          mcreqs_.push_back(multi_sim_comm.Ibcast(&mcscale_[2*first],2*(i+1-first),0));
+        }
+      } else scale_=mcscale_[2*i+1];
     }
   }
+  for(unsigned i=0;i<mcreqs_.size();++i) mcreqs_[i].wait();
+
   /* save the result of the sampling */
   if(doscale_) valueScale->set(scale_);
   for(unsigned i=0; i<sigma_.size(); i++) valueSigma[i]->set(sigma_[i]);
@@ -468,7 +533,7 @@ double Metainference::getEnergyForceSPE()
 
   const double smean2 = sigma_mean_*sigma_mean_; 
   const double s = sqrt( sigma_[0]*sigma_[0] + smean2 );
-  vector<double> f(narg,0);
+  vector<double> f(narg+1,0);
   
   if(comm.Get_rank()==0){
    for(unsigned i=0;i<narg;++i){
@@ -481,15 +546,18 @@ double Metainference::getEnergyForceSPE()
      ene += std::log(2.*a2*it);
      f[i] = -scale_*dev*(dit/smean2 + 1./a2);
    }
-   // collect contribution to forces and energy from other replicas
-   multi_sim_comm.Sum(&f[0],narg);
-   multi_sim_comm.Sum(&ene,1);
+   // collect contribution to forces and energy from other replicas,
+   // the energy is packed after the forces to use a single message
+   f[narg] = ene;
+   multi_sim_comm.Sum(&f[0],narg+1);
+   ene = f[narg];
    // add normalizations and priors of local replica
    ene += std::log(s) - static_cast<double>(ndata_)*std::log(sqrt2_div_pi*s);
+   f[narg] = ene;
   }
   // intra-replica summation
-  comm.Sum(&f[0],narg);
-  comm.Sum(&ene,1);
+  comm.Sum(&f[0],narg+1);
+  ene = f[narg];
 
   for(unsigned i=0; i<narg; ++i) setOutputForce(i, kbt_ * f[i]);
   return ene;
@@ -509,20 +577,27 @@ double Metainference::getEnergyForceGJE()
     if(comm.Get_rank()==0) inv_s2[i] = 1.0/ss[i];
   }
 
-  if(comm.Get_rank()==0) multi_sim_comm.Sum(&inv_s2[0],ssize); 
+  // the sum over replicas is nonblocking, so that it overlaps with the calculation of the deviations
+  const bool async = comm.Get_rank()==0 && nrep_>1;
+  Communicator::Request req;
+  if(async) req=multi_sim_comm.Isum(&inv_s2[0],ssize);
+
+  const unsigned narg=getNumberOfArguments();
+  vector<double> dev(narg);
+  for(unsigned i=0;i<narg;++i) dev[i] = scale_*getArgument(i)-parameters[i];
+
+  if(async) req.wait();
   comm.Sum(&inv_s2[0],ssize);  
   
-  const unsigned narg=getNumberOfArguments();
   for(unsigned i=0;i<narg;++i){
-    const double dev = scale_*getArgument(i)-parameters[i]; 
     unsigned sel_sigma=0;
     if(noise_type_==MGAUSS){
       sel_sigma=i;
       // add Jeffrey's prior - one per sigma
       ene += 0.5*std::log(ss[sel_sigma]);
     }
-    ene += 0.5*dev*dev*inv_s2[sel_sigma] + 0.5*std::log(ss[sel_sigma]*sqrt2_pi);
-    setOutputForce(i, -kbt_*dev*scale_*inv_s2[sel_sigma]);
+    ene += 0.5*dev[i]*dev[i]*inv_s2[sel_sigma] + 0.5*std::log(ss[sel_sigma]*sqrt2_pi);
+    setOutputForce(i, -kbt_*dev[i]*scale_*inv_s2[sel_sigma]);
   }
   // add Jeffrey's prior in case one sigma for all data points
   if(noise_type_==GAUSS) ene += 0.5*std::log(ss[0]);
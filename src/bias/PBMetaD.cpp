@@ -185,6 +185,9 @@ WALKERS_MPI
 ... PBMETAD
 PRINT ARG=d1,d2,pb.bias STRIDE=100 FILE=COLVAR
 \endverbatim
+As in \ref METAD, the keyword WALKERS_MPI_BATCH can be used to share the hills
+of several depositions in a single message, and the flag WALKERS_MPI_ASYNC to overlap
+the exchange with the following step using nonblocking communication.
 
 \par
 The disk version of multiple-walkers can be 
@@ -210,6 +213,9 @@ where  WALKERS_N is the total number of walkers, WALKERS_ID is the
 id of the present walker (starting from 0 ) and the WALKERS_DIR is the directory  
 where all the walkers are located. WALKERS_RSTRIDE is the number of step between 
 one update and the other. 
+As in \ref METAD, walkers running on the same node can share the bias grids in
+POSIX shared memory using the keyword WALKERS_SHM. In this case one shared memory
+segment is used for each bias, named after the WALKERS_SHM value followed by the index of the bias.
 
 */
 //+ENDPLUMEDOC
@@ -247,9 +253,21 @@ private:
   string mw_dir_;
   int mw_id_;
   int mw_rstride_;
+  string mw_shm_;
+  vector<SharedGrid*> sharedGrids_;
   bool    walkers_mpi;
   unsigned mpi_nw_;
   unsigned mpi_id_;
+// number of depositions exchanged among MPI walkers in a single message
+  unsigned mpi_batch_;
+  bool mpi_async_;
+  unsigned mpi_nbatched_;
+// packed hills waiting to be sent and hills currently being exchanged
+  vector<double> mpi_sendbuf_;
+  vector<double> mpi_inflight_;
+  vector<double> mpi_recvbuf_;
+  Communicator::Request mpi_request_;
+  bool mpi_pending_;
   vector<string> hillsfname;
   vector<IFile*> ifiles;
   vector<string> ifilesnames;
@@ -268,6 +286,8 @@ private:
   double evaluateGaussian(unsigned iarg, const vector<double>&, const Gaussian&,double* der=NULL);
   vector<unsigned> getGaussianSupport(unsigned iarg, const Gaussian&);
   bool   scanOneHill(unsigned iarg, IFile *ifile,  vector<Value> &v, vector<double> &center, vector<double>  &sigma, double &height, bool &multivariate);
+  void   startWalkersExchange();
+  void   finishWalkersExchange();
   std::string fmt;
 
 public:
@@ -305,18 +325,23 @@ void PBMetaD::registerKeywords(Keywords& keys){
   keys.add("optional","WALKERS_N", "number of walkers");
   keys.add("optional","WALKERS_DIR", "shared directory with the hills files from all the walkers");
   keys.add("optional","WALKERS_RSTRIDE","stride for reading hills files");
+  keys.add("optional","WALKERS_SHM","base name of the shared memory segments used to share the bias grids among the walkers running on the same node");
   keys.add("optional","INTERVAL_MIN","monodimensional lower limits, outside the limits the system will not feel the biasing force.");
   keys.add("optional","INTERVAL_MAX","monodimensional upper limits, outside the limits the system will not feel the biasing force.");
   keys.add("optional","ADAPTIVE","use a geometric (=GEOM) or diffusion (=DIFF) based hills width scheme. Sigma is one number that has distance units or timestep dimensions");
   keys.add("optional","SIGMA_MAX","the upper bounds for the sigmas (in CV units) when using adaptive hills. Negative number means no bounds ");
   keys.add("optional","SIGMA_MIN","the lower bounds for the sigmas (in CV units) when using adaptive hills. Negative number means no bounds ");
   keys.addFlag("WALKERS_MPI",false,"Switch on MPI version of multiple walkers - not compatible with WALKERS_* options other than WALKERS_DIR");
+  keys.add("optional","WALKERS_MPI_BATCH","with WALKERS_MPI, pack the hills of this number of depositions in a single message before sharing them with the other walkers");
+  keys.addFlag("WALKERS_MPI_ASYNC",false,"with WALKERS_MPI, share hills using nonblocking communication. Hills from the other walkers are added one step later");
   keys.use("RESTART");
   keys.use("UPDATE_FROM");
   keys.use("UPDATE_UNTIL");
 }
 
 PBMetaD::~PBMetaD(){
+  // do not leave a nonblocking exchange dangling
+  if(mpi_pending_ && mpi_async_ && comm.Get_rank()==0) mpi_request_.wait();
   for(unsigned i=0; i<BiasGrids_.size();   ++i) delete BiasGrids_[i];
   for(unsigned i=0; i<hillsOfiles_.size(); ++i){
    hillsOfiles_[i]->close();
@@ -339,8 +364,9 @@ PBMetaD::PBMetaD(const ActionOptions& ao):
 PLUMED_BIAS_INIT(ao),
 grid_(false), height0_(std::numeric_limits<double>::max()),
 biasf_(1.0), kbt_(0.0), stride_(0), wgridstride_(0), welltemp_(false),
-mw_n_(1), mw_dir_(""), mw_id_(0), mw_rstride_(1),
-walkers_mpi(false), mpi_nw_(0),
+mw_n_(1), mw_dir_(""), mw_id_(0), mw_rstride_(1), mw_shm_(""),
+walkers_mpi(false), mpi_nw_(0), mpi_id_(0),
+mpi_batch_(1), mpi_async_(false), mpi_nbatched_(0), mpi_pending_(false),
 adaptive_(FlexibleBin::none),
 isFirstStep(true)
 {
@@ -444,9 +470,14 @@ isFirstStep(true)
   if(mw_n_<=mw_id_) error("walker ID should be a numerical value less than the total number of walkers");
   parse("WALKERS_DIR",mw_dir_);
   parse("WALKERS_RSTRIDE",mw_rstride_);
+  parse("WALKERS_SHM",mw_shm_);
 
   // MPI version
   parseFlag("WALKERS_MPI",walkers_mpi);
+  parse("WALKERS_MPI_BATCH",mpi_batch_);
+  parseFlag("WALKERS_MPI_ASYNC",mpi_async_);
+  if(mpi_batch_<1) error("WALKERS_MPI_BATCH should be a positive integer");
+  if(!walkers_mpi && (mpi_batch_>1 || mpi_async_)) error("WALKERS_MPI_BATCH and WALKERS_MPI_ASYNC can only be used with WALKERS_MPI");
 
   // Grid file
   parse("GRID_WSTRIDE",wgridstride_);
@@ -518,6 +549,12 @@ isFirstStep(true)
   if(gbin.size()>0){grid_=true;}
   if(!grid_&&gridfilenames_.size() > 0) error("To write a grid you need first to define it!");
   if(!grid_&&gridreadfilenames_.size() > 0) error("To read a grid you need first to define it!");
+  if(mw_shm_.length()>0){
+    if(mw_n_<=1) error("WALKERS_SHM can only be used with WALKERS_N");
+    if(!grid_) error("WALKERS_SHM requires a grid");
+    if(sparsegrid) error("WALKERS_SHM is not compatible with GRID_SPARSE");
+    if(comm.Get_size()>1) error("WALKERS_SHM can only be used with a single MPI process per walker");
+  }
 
   doInt_.resize(getNumberOfArguments(),false);  
   // Interval keyword
@@ -556,6 +593,7 @@ isFirstStep(true)
     log.printf("  walker id %d\n",mw_id_);
     log.printf("  reading stride %d\n",mw_rstride_);
     if(mw_dir_!="")log.printf("  directory with hills files %s\n",mw_dir_.c_str());
+    if(mw_shm_.length()>0) log.printf("  bias grids shared among walkers in shared memory segments %s.*\n",mw_shm_.c_str());
   } else {
     if(walkers_mpi) {
       log.printf("  Multiple walkers active using MPI communnication\n"); 
@@ -569,6 +607,8 @@ isFirstStep(true)
       // info abount number of walkers and walker index
       comm.Bcast(mpi_nw_,0);
       comm.Bcast(mpi_id_,0);
+      if(mpi_batch_>1) log.printf("  hills are shared among walkers every %u depositions\n",mpi_batch_);
+      if(mpi_async_) log.printf("  hills are shared among walkers using nonblocking communication\n");
     }
   }
 
@@ -642,6 +682,20 @@ isFirstStep(true)
      string funcl = getLabel() + ".bias";
      BiasGrid_ = Grid::create(funcl, args, gridfile, gmin_t, gmax_t, gbin_t, sparsegrid, spline, true);
      gridfile.close();
+     if(mw_shm_.length()>0){
+      // only the walker that created the shared grid initializes it
+      std::string num; Tools::convert(i,num);
+      SharedGrid* sharedGrid=new SharedGrid(funcl,args,gmin_t,gmax_t,gbin_t,spline,true,mw_shm_+"."+num);
+      if(sharedGrid->isCreator()){
+       vector<double> der(1);
+       for(Grid::index_t j=0;j<BiasGrid_->getSize();++j){
+        double f=BiasGrid_->getValueAndDerivatives(j,der);
+        sharedGrid->setValueAndDerivatives(j,f,der);
+       }
+      }
+      delete BiasGrid_;
+      BiasGrid_=sharedGrid;
+     }
      if(BiasGrid_->getDimension() != args.size()) {
       error("mismatch between dimensionality of input grid and number of arguments");
      }
@@ -651,7 +705,11 @@ isFirstStep(true)
      log.printf("  Restarting from %s:",gridreadfilenames_[i].c_str());                  
      if(getRestart()) restartedFromGrid=true;
     } else {
-      if(!sparsegrid){BiasGrid_=new Grid(funcl,args,gmin_t,gmax_t,gbin_t,spline,true);}
+      if(mw_shm_.length()>0){
+       std::string num; Tools::convert(i,num);
+       BiasGrid_=new SharedGrid(funcl,args,gmin_t,gmax_t,gbin_t,spline,true,mw_shm_+"."+num);
+      }
+      else if(!sparsegrid){BiasGrid_=new Grid(funcl,args,gmin_t,gmax_t,gbin_t,spline,true);}
       else           {BiasGrid_=new SparseGrid(funcl,args,gmin_t,gmax_t,gbin_t,spline,true);}
       std::vector<std::string> actualmin=BiasGrid_->getMin();
       std::vector<std::string> actualmax=BiasGrid_->getMax();
@@ -659,6 +717,7 @@ isFirstStep(true)
       if(gmax_t[0]!=actualmax[0]) log<<"  WARNING: GRID_MAX["<<i<<"] has been adjusted to "<<actualmax[0]<<" to fit periodicity\n";
     }
     BiasGrids_.push_back(BiasGrid_);
+    if(mw_shm_.length()>0) sharedGrids_.push_back(static_cast<SharedGrid*>(BiasGrid_));
    }
   }
 
@@ -691,8 +750,17 @@ isFirstStep(true)
       ifiles.push_back(ifile);
       ifilesnames.push_back(fname);
       if(ifile->FileExist(fname)){
+        // a new shared grid does not contain the hills deposited by the other walkers in a previous run
+        if(sharedGrids_.size()>0 && sharedGrids_[i]->isCreator() && !getRestart() && j!=mw_id_){
+          for(unsigned l=0;l<BiasGrids_.size();++l) delete BiasGrids_[l];
+          BiasGrids_.clear(); sharedGrids_.clear();
+          std::string num; Tools::convert(i,num);
+          error("found hills file "+fname+" of another walker while creating shared memory segment "+mw_shm_+"."+num+
+                ": use RESTART to continue the simulation or remove the file to start a new one");
+        }
         ifile->open(fname);
-        if(getRestart()&&!restartedFromGrid){
+        // with shared grids, hills are read only by the walker that created the grid
+        if(getRestart()&&!restartedFromGrid&&(sharedGrids_.size()==0||sharedGrids_[i]->isCreator())){
           log.printf("  Restarting from %s:",ifilesnames[k].c_str());
           readGaussians(i,ifiles[k]);
         }
@@ -703,6 +771,11 @@ isFirstStep(true)
     }
   }
 
+  for(unsigned i=0;i<sharedGrids_.size();++i){
+    if(sharedGrids_[i]->isCreator()) sharedGrids_[i]->setReady();
+    else sharedGrids_[i]->waitReady();
+  }
+
   comm.Barrier();
   if(comm.Get_rank()==0 && walkers_mpi) multi_sim_comm.Barrier();
 
@@ -993,6 +1066,51 @@ void PBMetaD::calculate()
   setBias(ene);
 }
 
+void PBMetaD::startWalkersExchange(){
+  // the buffer being sent must stay untouched until the exchange is completed
+  mpi_inflight_.swap(mpi_sendbuf_);
+  mpi_sendbuf_.clear();
+  mpi_nbatched_=0;
+  mpi_recvbuf_.assign(mpi_nw_*mpi_inflight_.size(),0.0);
+  if(comm.Get_rank()==0){
+    // Communicate (only root)
+    if(mpi_async_) mpi_request_=multi_sim_comm.Iallgather(mpi_inflight_,mpi_recvbuf_);
+    else multi_sim_comm.Allgather(mpi_inflight_,mpi_recvbuf_);
+  }
+  mpi_pending_=true;
+  if(!mpi_async_) finishWalkersExchange();
+}
+
+void PBMetaD::finishWalkersExchange(){
+  if(comm.Get_rank()==0 && mpi_async_) mpi_request_.wait();
+  // Share info with group members
+  comm.Bcast(mpi_recvbuf_,0);
+  mpi_pending_=false;
+  const unsigned narg=getNumberOfArguments();
+  const unsigned ndep=mpi_inflight_.size()/(1+3*narg);
+  // own hills have been already added unless they are exchanged immediately
+  const bool skipown=(mpi_batch_>1 || mpi_async_);
+  vector<double> cv_tmp(1);
+  vector<double> sigma_tmp(1);
+  for(unsigned j=0; j<mpi_nw_; ++j){
+    if(skipown && j==mpi_id_) continue;
+    const double* p=&mpi_recvbuf_[j*mpi_inflight_.size()];
+    // now add hills one by one
+    for(unsigned k=0; k<ndep; ++k){
+      const bool multivariate=(p[0]>0.5);
+      p++;
+      for(unsigned i=0; i<narg; ++i){
+        cv_tmp[0]    = p[0];
+        sigma_tmp[0] = p[1];
+        Gaussian newhill = Gaussian(cv_tmp, sigma_tmp, p[2], multivariate);
+        addGaussian(i, newhill);
+        writeGaussian(i, newhill, hillsOfiles_[i]);
+        p+=3;
+      }
+    }
+  }
+}
+
 void PBMetaD::update()
 {
   bool multivariate;
@@ -1004,6 +1122,9 @@ void PBMetaD::update()
     isFirstStep=false;
   }
 
+  // add the hills received from the other MPI walkers at the previous step
+  if(mpi_pending_) finishWalkersExchange();
+
   // if you use adaptive, call the FlexibleBin 
   if(adaptive_!=FlexibleBin::none){
     for(unsigned i=0;i<getNumberOfArguments();i++) flexbin[i].update(nowAddAHill,i);
@@ -1044,38 +1165,25 @@ void PBMetaD::update()
 
    // MPI Multiple walkers: share hills and add them all
    if(walkers_mpi){
-     // Allocate arrays to store all walkers hills
-     std::vector<double> all_cv(mpi_nw_*cv.size(), 0.0);
-     std::vector<double> all_sigma(mpi_nw_*getNumberOfArguments(), 0.0);
-     std::vector<double> all_height(mpi_nw_*height.size(), 0.0);
-     if(comm.Get_rank()==0){
-       // fill in value
+     // layout of a packed deposition: multivariate, then center, sigma and height for each bias
+     mpi_sendbuf_.push_back(multivariate?1.0:0.0);
+     for(unsigned i=0; i<getNumberOfArguments(); ++i){
+       mpi_sendbuf_.push_back(cv[i]);
+       mpi_sendbuf_.push_back(thissigma[i]);
+       mpi_sendbuf_.push_back(height[i]);
+     }
+     mpi_nbatched_++;
+     // when hills are shared in batches or asynchronously, own hills are added immediately
+     if(mpi_batch_>1 || mpi_async_){
        for(unsigned i=0; i<getNumberOfArguments(); ++i){
-        unsigned j = mpi_id_ * getNumberOfArguments() + i;
-        all_cv[j] = cv[i];
-        all_sigma[j]  = thissigma[i];
-        all_height[j] = height[i];
+         cv_tmp[0] = cv[i];
+         sigma_tmp[0] = thissigma[i];
+         Gaussian newhill = Gaussian(cv_tmp, sigma_tmp, height[i], multivariate);
+         addGaussian(i, newhill);
+         writeGaussian(i, newhill, hillsOfiles_[i]);
        }
-       // Communicate (only root)
-       multi_sim_comm.Sum(&all_cv[0], all_cv.size());
-       multi_sim_comm.Sum(&all_sigma[0], all_sigma.size());
-       multi_sim_comm.Sum(&all_height[0], all_height.size());
      }
-     // Share info with group members
-     comm.Sum(&all_cv[0], all_cv.size());
-     comm.Sum(&all_sigma[0], all_sigma.size());
-     comm.Sum(&all_height[0], all_height.size());
-     // now add hills one by one
-     for(unsigned j=0; j<mpi_nw_; ++j){
-      for(unsigned i=0; i<getNumberOfArguments(); ++i){
-       cv_tmp[0]    = all_cv[j*cv.size()+i];
-       double height_tmp = all_height[j*cv.size()+i];
-       sigma_tmp[0] = all_sigma[j*cv.size()+i];
-       Gaussian newhill = Gaussian(cv_tmp, sigma_tmp, height_tmp, multivariate);
-       addGaussian(i, newhill);
-       writeGaussian(i, newhill, hillsOfiles_[i]);
-      }
-     }  
+     if(mpi_nbatched_==mpi_batch_) startWalkersExchange();
    // just add your own hills  
    }else{
     for(unsigned i=0; i<getNumberOfArguments(); ++i){
@@ -1106,7 +1214,8 @@ void PBMetaD::update()
    }
 
   // if multiple walkers and time to read Gaussians
-  if(mw_n_>1 && getStep()%mw_rstride_==0){
+  // (not needed with shared grids, since the other walkers deposit directly on them)
+  if(mw_n_>1 && sharedGrids_.size()==0 && getStep()%mw_rstride_==0){
     for(int j=0;j<mw_n_;++j){
       for(unsigned i=0;i<hillsfname.size();++i){
         unsigned k=j*hillsfname.size()+i;
@@ -463,9 +463,13 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc){
     } 
     p.cmd("setMPIComm",&intracomm.Get_comm());
   } 
-  p.cmd("setMDLengthUnits",&units.getLength());
-  p.cmd("setMDChargeUnits",&units.getCharge());
-  p.cmd("setMDMassUnits",&units.getMass());
+// units should be passed with the same precision used for the other reals
+  real mdLengthUnits=units.getLength();
+  real mdChargeUnits=units.getCharge();
+  real mdMassUnits=units.getMass();
+  p.cmd("setMDLengthUnits",&mdLengthUnits);
+  p.cmd("setMDChargeUnits",&mdChargeUnits);
+  p.cmd("setMDMassUnits",&mdMassUnits);
   p.cmd("setMDEngine","driver");
   p.cmd("setTimestep",&timestep);
   p.cmd("setPlumedDat",plumedFile.c_str());
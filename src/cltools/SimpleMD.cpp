@@ -24,10 +24,14 @@
 #include "wrapper/Plumed.h"
 #include "tools/Vector.h"
 #include "tools/Random.h"
+#include "tools/OpenMP.h"
+#include "tools/Stopwatch.h"
+#include "tools/Communicator.h"
 #include <string>
 #include <cstdio>
 #include <cmath>
 #include <vector>
+#include <algorithm>
 
 using namespace std;
 
@@ -70,6 +74,32 @@ input file will be output.
 plumed simplemd --help
 \endverbatim
 
+Neighbour lists are built with a cell list whenever the box is at least three list cutoffs
+wide in every direction, and both the neighbour list and the forces are computed using
+the number of OpenMP threads set with the PLUMED_NUM_THREADS environment variable.
+When simplemd is run with more than one MPI process, atoms are distributed among the processes
+in slabs along the x direction and each process computes the forces on the pairs involving the
+atoms it owns. Only these atoms are passed to PLUMED, using the same domain decomposition
+interface that is used by MD codes (setAtomsNlocal and setAtomsGatindex).
+Positions and velocities are replicated on all the processes.
+
+Setting benchmark to true makes simplemd print at the end of the run the time spent
+in the different parts of the MD step, including the fraction of time spent inside PLUMED.
+The following input can be used to measure the overhead of the PLUMED input contained in file bench.dat:
+\verbatim
+inputfile input.xyz
+outputfile output.xyz
+temperature 0.722
+tstep 0.005
+friction 1
+nstep 1000
+nconfig 1000 trajectory.xyz
+nstat   1000 energies.dat
+plumed bench.dat
+benchmark true
+\endverbatim
+The same input with plumed set to none can be used to time the MD code alone.
+
 */
 //+ENDPLUMEDOC
 
@@ -102,6 +132,8 @@ static void registerKeywords( Keywords& keys ){
   keys.add("compulsory","idum","0","The random number seed");
   keys.add("compulsory","ndim","3","The dimensionality of the system (some interesting LJ clusters are two dimensional)");
   keys.add("compulsory","wrapatoms","false","If true, atomic coordinates are written wrapped in minimal cell");
+  keys.add("compulsory","plumed","plumed.dat","The PLUMED input file. Use none to run without PLUMED");
+  keys.add("compulsory","benchmark","false","If true, the time spent in the different parts of the MD step is reported at the end of the run");
 }
 
 explicit SimpleMD( const CLToolOptions& co ) :
@@ -126,6 +158,8 @@ read_input(double& temperature,
            int&    nconfig,
            int&    nstat,
            bool&   wrapatoms,
+           bool&   benchmark,
+           string& plumedfile,
            string& inputfile,
            string& outputfile,
            string& trajfile,
@@ -185,6 +219,10 @@ read_input(double& temperature,
   parse("wrapatoms",w);
   wrapatoms=false;
   if(w.length()>0 && (w[0]=='T' || w[0]=='t')) wrapatoms=true;
+  parse("benchmark",w);
+  benchmark=false;
+  if(w.length()>0 && (w[0]=='T' || w[0]=='t')) benchmark=true;
+  parse("plumed",plumedfile);
 }
 
 void read_natoms(const string & inputfile,int & natoms){
@@ -248,65 +286,164 @@ void check_list(const int natoms,const vector<Vector>& positions,const vector<Ve
 }
 
 
+void decompose(const int natoms,const vector<Vector>& positions,const double cell[3],const int rank,const int nproc,
+               vector<int>& gatindex){
+// assign atoms to processes in slabs along x
+// gatindex contains the (sorted) indexes of the atoms owned by this process
+  gatindex.clear();
+  for(int iatom=0;iatom<natoms;iatom++){
+    double s=positions[iatom][0]/cell[0];
+    s-=floor(s);
+    int owner=int(s*nproc);
+    if(owner>=nproc) owner=nproc-1;
+    if(owner==rank) gatindex.push_back(iatom);
+  }
+}
+
 void compute_list(const int natoms,const int listsize,const vector<Vector>& positions,const double cell[3],const double listcutoff,
-                  vector<int>& point,vector<int>& list){
+                  const vector<int>& gatindex,vector<vector<int> >& neighbours,vector<int>& point,vector<int>& list){
 // see Allen-Tildesey for a definition of point and list
-  Vector distance;     // distance of the two atoms
-  Vector distance_pbc; // minimum-image distance of the two atoms
+// neighbours are only searched for the atoms in gatindex, and for each atom they are sorted
+// so that the list is identical to the one obtained looping on all pairs
   double listcutoff2;  // squared list cutoff
   listcutoff2=listcutoff*listcutoff;
+
+// a cell list is used if there are at least three cells in each direction
+  int ncell[3];
+  bool usecells=true;
+  for(int k=0;k<3;k++){
+    ncell[k]=int(floor(cell[k]/listcutoff));
+    if(ncell[k]<3) usecells=false;
+  }
+  vector<int> atomcell;   // cell of each atom
+  vector<int> cellstart;  // atoms in cell i are cellatoms[cellstart[i]] ... cellatoms[cellstart[i+1]-1]
+  vector<int> cellatoms;
+  if(usecells){
+    int ncells=ncell[0]*ncell[1]*ncell[2];
+    atomcell.resize(natoms);
+    cellstart.assign(ncells+1,0);
+    for(int iatom=0;iatom<natoms;iatom++){
+      int c[3];
+      for(int k=0;k<3;k++){
+        double s=positions[iatom][k]/cell[k];
+        s-=floor(s);
+        c[k]=int(s*ncell[k]);
+        if(c[k]>=ncell[k]) c[k]=ncell[k]-1;
+      }
+      atomcell[iatom]=(c[0]*ncell[1]+c[1])*ncell[2]+c[2];
+      cellstart[atomcell[iatom]+1]++;
+    }
+    for(int i=0;i<ncells;i++) cellstart[i+1]+=cellstart[i];
+    cellatoms.resize(natoms);
+    vector<int> next(cellstart.begin(),cellstart.end()-1);
+    for(int iatom=0;iatom<natoms;iatom++) cellatoms[next[atomcell[iatom]]++]=iatom;
+  }
+
+// the neighbours of each atom are collected in separate vectors, whose storage is kept between calls
+  neighbours.resize(natoms);
+  for(int iatom=0;iatom<natoms;iatom++) neighbours[iatom].clear();
+  int nlocal=gatindex.size();
+  unsigned nt=OpenMP::getNumThreads();
+  if(nt*10>unsigned(nlocal)) nt=nlocal/10;
+  if(nt==0) nt=1;
+  #pragma omp parallel for num_threads(nt) schedule(dynamic,16)
+  for(int i=0;i<nlocal;i++){
+    int iatom=gatindex[i];
+    vector<int> & neigh(neighbours[iatom]);
+    Vector distance;     // distance of the two atoms
+    Vector distance_pbc; // minimum-image distance of the two atoms
+    if(usecells){
+      int c[3];
+      c[2]=atomcell[iatom]%ncell[2];
+      c[1]=(atomcell[iatom]/ncell[2])%ncell[1];
+      c[0]=atomcell[iatom]/(ncell[2]*ncell[1]);
+      for(int dx=-1;dx<=1;dx++) for(int dy=-1;dy<=1;dy++) for(int dz=-1;dz<=1;dz++){
+        int cx=(c[0]+dx+ncell[0])%ncell[0];
+        int cy=(c[1]+dy+ncell[1])%ncell[1];
+        int cz=(c[2]+dz+ncell[2])%ncell[2];
+        int jcell=(cx*ncell[1]+cy)*ncell[2]+cz;
+        for(int j=cellstart[jcell];j<cellstart[jcell+1];j++){
+          int jatom=cellatoms[j];
+          if(jatom<=iatom) continue;
+          for(int k=0;k<3;k++) distance[k]=positions[iatom][k]-positions[jatom][k];
+          pbc(cell,distance,distance_pbc);
+          double d2=0; for(int k=0;k<3;k++) d2+=distance_pbc[k]*distance_pbc[k];
+          if(d2>listcutoff2)continue;
+          neigh.push_back(jatom);
+        }
+      }
+      std::sort(neigh.begin(),neigh.end());
+    } else {
+      for(int jatom=iatom+1;jatom<natoms;jatom++){
+        for(int k=0;k<3;k++) distance[k]=positions[iatom][k]-positions[jatom][k];
+        pbc(cell,distance,distance_pbc);
+// if the interparticle distance is larger than the cutoff, skip
+        double d2=0; for(int k=0;k<3;k++) d2+=distance_pbc[k]*distance_pbc[k];
+        if(d2>listcutoff2)continue;
+        neigh.push_back(jatom);
+      }
+    }
+  }
+
   point[0]=0;
   for(int iatom=0;iatom<natoms-1;iatom++){
-    point[iatom+1]=point[iatom];
-    for(int jatom=iatom+1;jatom<natoms;jatom++){
-      for(int k=0;k<3;k++) distance[k]=positions[iatom][k]-positions[jatom][k];
-      pbc(cell,distance,distance_pbc);
-// if the interparticle distance is larger than the cutoff, skip
-      double d2=0; for(int k=0;k<3;k++) d2+=distance_pbc[k]*distance_pbc[k];
-      if(d2>listcutoff2)continue;
-      if(point[iatom+1]>listsize){
+    point[iatom+1]=point[iatom]+neighbours[iatom].size();
+    if(point[iatom+1]>listsize){
 // too many neighbours
-        fprintf(stderr,"%s","Verlet list size exceeded\n");
-        fprintf(stderr,"%s","Increase maxneighbours\n");
-        exit(1);
-      }
-      list[point[iatom+1]]=jatom;
-      point[iatom+1]++;
+      fprintf(stderr,"%s","Verlet list size exceeded\n");
+      fprintf(stderr,"%s","Increase maxneighbours\n");
+      exit(1);
     }
+    std::copy(neighbours[iatom].begin(),neighbours[iatom].end(),list.begin()+point[iatom]);
   }
 }
 
 void compute_forces(const int natoms,const int listsize,const vector<Vector>& positions,const double cell[3],
                     double forcecutoff,const vector<int>& point,const vector<int>& list,vector<Vector>& forces,double & engconf)
 {
-  Vector distance;        // distance of the two atoms
-  Vector distance_pbc;    // minimum-image distance of the two atoms
-  double distance_pbc2;   // squared minimum-image distance
   double forcecutoff2;    // squared force cutoff
-  Vector f;               // force
   double engcorrection;   // energy necessary shift the potential avoiding discontinuities
 
   forcecutoff2=forcecutoff*forcecutoff;
   engconf=0.0;
   for(int i=0;i<natoms;i++)for(int k=0;k<3;k++) forces[i][k]=0.0;
   engcorrection=4.0*(1.0/pow(forcecutoff2,6.0)-1.0/pow(forcecutoff2,3));
-  for(int iatom=0;iatom<natoms-1;iatom++){
-    for(int jlist=point[iatom];jlist<point[iatom+1];jlist++){
-      int jatom=list[jlist];
-      for(int k=0;k<3;k++) distance[k]=positions[iatom][k]-positions[jatom][k];
-      pbc(cell,distance,distance_pbc);
-      distance_pbc2=0.0; for(int k=0;k<3;k++) distance_pbc2+=distance_pbc[k]*distance_pbc[k];
+  unsigned nt=OpenMP::getNumThreads();
+  if(nt*10>unsigned(natoms)) nt=natoms/10;
+  if(nt==0) nt=1;
+// each thread accumulates forces on its own copy, which are then summed
+  #pragma omp parallel num_threads(nt)
+  {
+    vector<Vector> omp_forces(natoms);
+    double omp_engconf=0.0;
+    Vector distance;        // distance of the two atoms
+    Vector distance_pbc;    // minimum-image distance of the two atoms
+    double distance_pbc2;   // squared minimum-image distance
+    Vector f;               // force
+    #pragma omp for schedule(dynamic,16) nowait
+    for(int iatom=0;iatom<natoms-1;iatom++){
+      for(int jlist=point[iatom];jlist<point[iatom+1];jlist++){
+        int jatom=list[jlist];
+        for(int k=0;k<3;k++) distance[k]=positions[iatom][k]-positions[jatom][k];
+        pbc(cell,distance,distance_pbc);
+        distance_pbc2=0.0; for(int k=0;k<3;k++) distance_pbc2+=distance_pbc[k]*distance_pbc[k];
 // if the interparticle distance is larger than the cutoff, skip
-      if(distance_pbc2>forcecutoff2) continue;
-      double distance_pbc6=distance_pbc2*distance_pbc2*distance_pbc2;
-      double distance_pbc8=distance_pbc6*distance_pbc2;
-      double distance_pbc12=distance_pbc6*distance_pbc6;
-      double distance_pbc14=distance_pbc12*distance_pbc2;
-      engconf+=4.0*(1.0/distance_pbc12 - 1.0/distance_pbc6) - engcorrection;
-      for(int k=0;k<3;k++) f[k]=2.0*distance_pbc[k]*4.0*(6.0/distance_pbc14-3.0/distance_pbc8);
+        if(distance_pbc2>forcecutoff2) continue;
+        double distance_pbc6=distance_pbc2*distance_pbc2*distance_pbc2;
+        double distance_pbc8=distance_pbc6*distance_pbc2;
+        double distance_pbc12=distance_pbc6*distance_pbc6;
+        double distance_pbc14=distance_pbc12*distance_pbc2;
+        omp_engconf+=4.0*(1.0/distance_pbc12 - 1.0/distance_pbc6) - engcorrection;
+        for(int k=0;k<3;k++) f[k]=2.0*distance_pbc[k]*4.0*(6.0/distance_pbc14-3.0/distance_pbc8);
 // same force on the two atoms, with opposite sign:
-      for(int k=0;k<3;k++) forces[iatom][k]+=f[k];
-      for(int k=0;k<3;k++) forces[jatom][k]-=f[k];
+        for(int k=0;k<3;k++) omp_forces[iatom][k]+=f[k];
+        for(int k=0;k<3;k++) omp_forces[jatom][k]-=f[k];
+      }
+    }
+    #pragma omp critical
+    {
+      for(int i=0;i<natoms;i++) forces[i]+=omp_forces[i];
+      engconf+=omp_engconf;
     }
   }
 }
@@ -413,8 +550,16 @@ virtual int main(FILE* in,FILE*out,PLMD::Communicator& pc){
   int            listsize;     // size of the list array
   vector<int>    list;         // neighbour list
   vector<int>    point;        // pointer to neighbour list
+  vector<vector<int> > neighbours; // neighbours of each atom, used while building the list
   vector<Vector> positions0;   // reference atomic positions, i.e. positions when the neighbour list
 
+// domain decomposition variables (only used when running with more than one process)
+  bool           dd;           // true if atoms are distributed among processes
+  vector<int>    gatindex;     // global indexes of the atoms owned by this process
+  vector<Vector> lpositions;   // positions of the local atoms
+  vector<Vector> lforces;      // forces on the local atoms
+  vector<double> lmasses;      // masses of the local atoms
+
 // input parameters
 // all of them have a reasonable default value, set in read_input()
   double      tstep;             // simulation timestep
@@ -430,6 +575,8 @@ virtual int main(FILE* in,FILE*out,PLMD::Communicator& pc){
   int         idum;              // seed
   int         plumedWantsToStop; // stop flag
   bool        wrapatoms;         // if true, atomic coordinates are written wrapped in minimal cell
+  bool        benchmark;         // if true, timings are reported at the end of the run
+  string      plumedfile;        // name of the PLUMED input file
   string      inputfile;         // name of file with starting configuration (xyz)
   string      outputfile;        // name of file with final configuration (xyz)
   string      trajfile;          // name of the trajectory file (xyz)
@@ -443,42 +590,59 @@ virtual int main(FILE* in,FILE*out,PLMD::Communicator& pc){
 
   Random random;                 // random numbers stream
 
+  Stopwatch sw;                  // timers used in benchmark mode
+  unsigned swStep=sw.getHandle("MD step");
+  unsigned swList=sw.getHandle("Neighbour list");
+  unsigned swForces=sw.getHandle("Forces");
+  unsigned swPlumed=sw.getHandle("PLUMED");
+
   PLMD::Plumed* plumed=NULL;
 
-// Commenting the next line it is possible to switch-off plumed
-  plumed=new PLMD::Plumed;
+  read_input(temperature,tstep,friction,forcecutoff,
+             listcutoff,nstep,nconfig,nstat,
+             wrapatoms,benchmark,plumedfile,inputfile,outputfile,trajfile,statfile,
+             maxneighbour,ndim,idum);
+
+// Setting plumed to none it is possible to switch-off plumed
+  if(plumedfile!="none") plumed=new PLMD::Plumed;
 
   if(plumed){
     int s=sizeof(double);
     plumed->cmd("setRealPrecision",&s);
   }
 
-  read_input(temperature,tstep,friction,forcecutoff,
-             listcutoff,nstep,nconfig,nstat,
-             wrapatoms,inputfile,outputfile,trajfile,statfile,
-             maxneighbour,ndim,idum);
+// only the first process writes output
+  int rank=pc.Get_rank();
+  int nproc=pc.Get_size();
+  dd=(nproc>1);
+  if(rank!=0) out=NULL;
 
 // number of atoms is read from file inputfile
   read_natoms(inputfile,natoms);
 
 // write the parameters in output so they can be checked
-  fprintf(out,"%s %s\n","Starting configuration           :",inputfile.c_str());
-  fprintf(out,"%s %s\n","Final configuration              :",outputfile.c_str());
-  fprintf(out,"%s %d\n","Number of atoms                  :",natoms);
-  fprintf(out,"%s %f\n","Temperature                      :",temperature);
-  fprintf(out,"%s %f\n","Time step                        :",tstep);
-  fprintf(out,"%s %f\n","Friction                         :",friction);
-  fprintf(out,"%s %f\n","Cutoff for forces                :",forcecutoff);
-  fprintf(out,"%s %f\n","Cutoff for neighbour list        :",listcutoff);
-  fprintf(out,"%s %d\n","Number of steps                  :",nstep);
-  fprintf(out,"%s %d\n","Stride for trajectory            :",nconfig);
-  fprintf(out,"%s %s\n","Trajectory file                  :",trajfile.c_str());
-  fprintf(out,"%s %d\n","Stride for statistics            :",nstat);
-  fprintf(out,"%s %s\n","Statistics file                  :",statfile.c_str());
-  fprintf(out,"%s %d\n","Max average number of neighbours :",maxneighbour);
-  fprintf(out,"%s %d\n","Dimensionality                   :",ndim);
-  fprintf(out,"%s %d\n","Seed                             :",idum);
-  fprintf(out,"%s %s\n","Are atoms wrapped on output?     :",(wrapatoms?"T":"F"));
+  if(out){
+    fprintf(out,"%s %s\n","Starting configuration           :",inputfile.c_str());
+    fprintf(out,"%s %s\n","Final configuration              :",outputfile.c_str());
+    fprintf(out,"%s %d\n","Number of atoms                  :",natoms);
+    fprintf(out,"%s %f\n","Temperature                      :",temperature);
+    fprintf(out,"%s %f\n","Time step                        :",tstep);
+    fprintf(out,"%s %f\n","Friction                         :",friction);
+    fprintf(out,"%s %f\n","Cutoff for forces                :",forcecutoff);
+    fprintf(out,"%s %f\n","Cutoff for neighbour list        :",listcutoff);
+    fprintf(out,"%s %d\n","Number of steps                  :",nstep);
+    fprintf(out,"%s %d\n","Stride for trajectory            :",nconfig);
+    fprintf(out,"%s %s\n","Trajectory file                  :",trajfile.c_str());
+    fprintf(out,"%s %d\n","Stride for statistics            :",nstat);
+    fprintf(out,"%s %s\n","Statistics file                  :",statfile.c_str());
+    fprintf(out,"%s %d\n","Max average number of neighbours :",maxneighbour);
+    fprintf(out,"%s %d\n","Dimensionality                   :",ndim);
+    fprintf(out,"%s %d\n","Seed                             :",idum);
+    fprintf(out,"%s %s\n","Are atoms wrapped on output?     :",(wrapatoms?"T":"F"));
+    fprintf(out,"%s %s\n","PLUMED input file                :",plumedfile.c_str());
+    fprintf(out,"%s %d\n","Number of processes              :",nproc);
+    fprintf(out,"%s %d\n","Number of threads                :",OpenMP::getNumThreads());
+  }
 
 // Setting the seed
   random.setSeed(idum);
@@ -513,7 +677,8 @@ virtual int main(FILE* in,FILE*out,PLMD::Communicator& pc){
     plumed->cmd("setNatoms",&natoms);
     plumed->cmd("setMDEngine","simpleMD");
     plumed->cmd("setTimestep",&tstep);
-    plumed->cmd("setPlumedDat","plumed.dat");
+    plumed->cmd("setPlumedDat",plumedfile.c_str());
+    if(dd) plumed->cmd("setMPIComm",&pc.Get_comm());
     int pversion=0;
     plumed->cmd("getApiVersion",&pversion);
 // setting kbT is only implemented with api>1
@@ -525,14 +690,27 @@ virtual int main(FILE* in,FILE*out,PLMD::Communicator& pc){
     plumed->cmd("init");
   }
 
+// atoms are assigned to processes
+  if(dd) decompose(natoms,positions,cell,rank,nproc,gatindex);
+  else {
+    gatindex.resize(natoms);
+    for(int iatom=0;iatom<natoms;++iatom) gatindex[iatom]=iatom;
+  }
+
 // neighbour list are computed, and reference positions are saved
-  compute_list(natoms,listsize,positions,cell,listcutoff,point,list);
+  compute_list(natoms,listsize,positions,cell,listcutoff,gatindex,neighbours,point,list);
 
-  fprintf(out,"List size: %d\n",point[natoms-1]);
+  int listtot=point[natoms-1];
+  if(dd) pc.Sum(listtot);
+  if(out) fprintf(out,"List size: %d\n",listtot);
   for(int iatom=0;iatom<natoms;++iatom) for(int k=0;k<3;++k) positions0[iatom][k]=positions[iatom][k];
 
 // forces are computed before starting md
   compute_forces(natoms,listsize,positions,cell,forcecutoff,point,list,forces,engconf);
+  if(dd){
+    pc.Sum(forces);
+    pc.Sum(engconf);
+  }
 
 // remove forces if ndim<3
   if(ndim<3)
@@ -550,6 +728,7 @@ virtual int main(FILE* in,FILE*out,PLMD::Communicator& pc){
 //   thermostat
 //   (eventually dump output informations)
   for(int istep=0;istep<nstep;istep++){
+    if(benchmark) sw.start(swStep);
     thermostat(natoms,ndim,masses,0.5*tstep,friction,temperature,velocities,engint,random);
 
     for(int iatom=0;iatom<natoms;iatom++) for(int k=0;k<3;k++)
@@ -561,28 +740,64 @@ virtual int main(FILE* in,FILE*out,PLMD::Communicator& pc){
 // a check is performed to decide whether to recalculate the neighbour list
     check_list(natoms,positions,positions0,listcutoff,forcecutoff,recompute_list);
     if(recompute_list){
-      compute_list(natoms,listsize,positions,cell,listcutoff,point,list);
+      if(benchmark) sw.start(swList);
+      if(dd) decompose(natoms,positions,cell,rank,nproc,gatindex);
+      compute_list(natoms,listsize,positions,cell,listcutoff,gatindex,neighbours,point,list);
+      if(benchmark) sw.stop(swList);
       for(int iatom=0;iatom<natoms;++iatom) for(int k=0;k<3;++k) positions0[iatom][k]=positions[iatom][k];
-      fprintf(out,"Neighbour list recomputed at step %d\n",istep);
-      fprintf(out,"List size: %d\n",point[natoms-1]);
+      listtot=point[natoms-1];
+      if(dd) pc.Sum(listtot);
+      if(out) fprintf(out,"Neighbour list recomputed at step %d\n",istep);
+      if(out) fprintf(out,"List size: %d\n",listtot);
     }
 
+    if(benchmark) sw.start(swForces);
     compute_forces(natoms,listsize,positions,cell,forcecutoff,point,list,forces,engconf);
+    if(benchmark) sw.stop(swForces);
 
     if(plumed){
+      if(benchmark) sw.start(swPlumed);
       int istepplusone=istep+1;
       plumedWantsToStop=0;
       for(int i=0;i<3;i++)for(int k=0;k<3;k++) cell9[i][k]=0.0;
       for(int i=0;i<3;i++) cell9[i][i]=cell[i];
       plumed->cmd("setStep",&istepplusone);
-      plumed->cmd("setMasses",&masses[0]);
-      plumed->cmd("setForces",&forces[0]);
+      if(dd){
+// only local atoms are passed, forces on them are still partial sums here
+        int nlocal=gatindex.size();
+        lpositions.resize(nlocal);
+        lforces.resize(nlocal);
+        lmasses.resize(nlocal);
+        for(int i=0;i<nlocal;i++){
+          lpositions[i]=positions[gatindex[i]];
+          lforces[i]=forces[gatindex[i]];
+          lmasses[i]=masses[gatindex[i]];
+        }
+        plumed->cmd("setAtomsNlocal",&nlocal);
+        plumed->cmd("setAtomsGatindex",(nlocal>0?&gatindex[0]:NULL));
+        plumed->cmd("setMasses",(nlocal>0?&lmasses[0]:NULL));
+        plumed->cmd("setForces",(nlocal>0?&lforces[0]:NULL));
+        plumed->cmd("setPositions",(nlocal>0?&lpositions[0]:NULL));
+      } else {
+        plumed->cmd("setMasses",&masses[0]);
+        plumed->cmd("setForces",&forces[0]);
+        plumed->cmd("setPositions",&positions[0]);
+      }
       plumed->cmd("setEnergy",&engconf);
-      plumed->cmd("setPositions",&positions[0]);
       plumed->cmd("setBox",cell9);
       plumed->cmd("setStopFlag",&plumedWantsToStop);
       plumed->cmd("calc");
+      if(dd) for(unsigned i=0;i<gatindex.size();i++) forces[gatindex[i]]=lforces[i];
       if(plumedWantsToStop) nstep=istep;
+      if(benchmark) sw.stop(swPlumed);
+    }
+
+// partial forces and energies are summed over processes
+    if(dd){
+      if(benchmark) sw.start(swForces);
+      pc.Sum(forces);
+      pc.Sum(engconf);
+      if(benchmark) sw.stop(swForces);
     }
 // remove forces if ndim<3
    if(ndim<3)
@@ -592,18 +807,39 @@ virtual int main(FILE* in,FILE*out,PLMD::Communicator& pc){
       velocities[iatom][k]+=forces[iatom][k]*0.5*tstep/masses[iatom];
 
     thermostat(natoms,ndim,masses,0.5*tstep,friction,temperature,velocities,engint,random);
+    if(benchmark) sw.stop(swStep);
 
 // kinetic energy is calculated
   compute_engkin(natoms,masses,velocities,engkin);
 
 // eventually, write positions and statistics
-    if((istep+1)%nconfig==0) write_positions(trajfile,natoms,positions,cell,wrapatoms);
-    if((istep+1)%nstat==0)   write_statistics(statfile,istep+1,tstep,natoms,ndim,engkin,engconf,engint);
+    if(rank==0 && (istep+1)%nconfig==0) write_positions(trajfile,natoms,positions,cell,wrapatoms);
+    if(rank==0 && (istep+1)%nstat==0)   write_statistics(statfile,istep+1,tstep,natoms,ndim,engkin,engconf,engint);
 
   }
 
 // write final positions
-  write_final_positions(outputfile,natoms,positions,cell,wrapatoms);
+  if(rank==0) write_final_positions(outputfile,natoms,positions,cell,wrapatoms);
+
+// timings are averaged over processes
+  if(benchmark){
+    double times[4];
+    times[0]=sw.getTotal(swStep);
+    times[1]=sw.getTotal(swList);
+    times[2]=sw.getTotal(swForces);
+    times[3]=sw.getTotal(swPlumed);
+    pc.Sum(times,4);
+    for(int i=0;i<4;i++) times[i]/=nproc;
+    if(out){
+      fprintf(out,"Benchmark (seconds, averaged over %d processes):\n",nproc);
+      fprintf(out,"%s %f\n","Total time in MD steps           :",times[0]);
+      fprintf(out,"%s %f\n","Time per step                    :",(nstep>0?times[0]/nstep:0.0));
+      fprintf(out,"%s %f\n","Neighbour list                   :",times[1]);
+      fprintf(out,"%s %f\n","Forces                           :",times[2]);
+      fprintf(out,"%s %f\n","PLUMED                           :",times[3]);
+      fprintf(out,"%s %f\n","PLUMED fraction of step time     :",(times[0]>0.0?times[3]/times[0]:0.0));
+    }
+  }
 
 // close the statistic file if it was open:
   if(write_statistics_fp) fclose(write_statistics_fp);
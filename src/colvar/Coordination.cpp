@@ -98,6 +98,7 @@ public:
 // active methods:
   static void registerKeywords( Keywords& keys );
   virtual double pairing(double distance,double&dfunc,unsigned i,unsigned j)const;
+  virtual void pairingBlock(unsigned n,const double*distance2,double*value,double*dfunc,const unsigned*i,const unsigned*j)const;
 };
 
 PLUMED_REGISTER_ACTION(Coordination,"COORDINATION")
@@ -147,6 +148,12 @@ double Coordination::pairing(double distance,double&dfunc,unsigned i,unsigned j)
   return switchingFunction.calculateSqr(distance,dfunc);
 }
 
+void Coordination::pairingBlock(unsigned n,const double*distance2,double*value,double*dfunc,const unsigned*i,const unsigned*j)const{
+  (void) i; // avoid warnings
+  (void) j; // avoid warnings
+  switchingFunction.calculateSqr(n,distance2,value,dfunc);
+}
+
 }
 
 }
@@ -127,6 +127,13 @@ void CoordinationBase::prepare(){
   }
 }
 
+void CoordinationBase::pairingBlock(unsigned n,const double*distance2,double*value,double*dfunc,const unsigned*i,const unsigned*j)const{
+  for(unsigned k=0;k<n;k++){
+    dfunc[k]=0.;
+    value[k]=pairing(distance2[k],dfunc[k],i[k],j[k]);
+  }
+}
+
 // calculator
 void CoordinationBase::calculate()
 {
@@ -157,30 +164,48 @@ const unsigned nn=nl->size();
 if(nt*stride*10>nn) nt=nn/stride/10;
 if(nt==0)nt=1;
 
+// pairs are processed in blocks, so that pbc can be applied to all the distances in a block at once
+const unsigned nblock=64;
+const unsigned nmine=(nn>rank ? (nn-rank+stride-1)/stride : 0);
+
 #pragma omp parallel num_threads(nt)
 {
  std::vector<Vector> omp_deriv(getPositions().size());
  Tensor omp_virial;
+ std::vector<Vector> distances(nblock);
+ std::vector<double> distance2(nblock),value(nblock),dfunc(nblock);
+ std::vector<unsigned> index0(nblock),index1(nblock);
 
 #pragma omp for reduction(+:ncoord) nowait
- for(unsigned int i=rank;i<nn;i+=stride) {   
+ for(unsigned int ib=0;ib<nmine;ib+=nblock) {
  
-  Vector distance;
-  unsigned i0=nl->getClosePair(i).first;
-  unsigned i1=nl->getClosePair(i).second;
+  const unsigned nlast=(ib+nblock<nmine ? ib+nblock : nmine);
+// pairs made of the same atom are skipped, so that a block can contain less than nblock pairs
+  unsigned nb=0;
+  for(unsigned k=ib;k<nlast;k++){
+   const unsigned i=rank+k*stride;
+   const unsigned i0=nl->getClosePair(i).first;
+   const unsigned i1=nl->getClosePair(i).second;
+   if(getAbsoluteIndex(i0)==getAbsoluteIndex(i1)) continue;
+   index0[nb]=i0;
+   index1[nb]=i1;
+   distances[nb]=delta(getPosition(i0),getPosition(i1));
+   nb++;
+  }
+  if(pbc) pbcApply(distances,nb);
 
-  if(getAbsoluteIndex(i0)==getAbsoluteIndex(i1)) continue;
+  for(unsigned j=0;j<nb;j++) distance2[j]=distances[j].modulo2();
+  pairingBlock(nb,&distance2[0],&value[0],&dfunc[0],&index0[0],&index1[0]);
 
-  if(pbc){
-   distance=pbcDistance(getPosition(i0),getPosition(i1));
-  } else {
-   distance=delta(getPosition(i0),getPosition(i1));
-  }
+  for(unsigned j=0;j<nb;j++){
 
-  double dfunc=0.;
-  ncoord += pairing(distance.modulo2(), dfunc,i0,i1);
+  const unsigned i0=index0[j];
+  const unsigned i1=index1[j];
+  const Vector& distance(distances[j]);
 
-  Vector dd(dfunc*distance);
+  ncoord += value[j];
+
+  Vector dd(dfunc[j]*distance);
   Tensor vv(dd,distance);
   if(nt>1){
     omp_deriv[i0]-=dd;
@@ -192,6 +217,7 @@ if(nt==0)nt=1;
     virial-=vv;
   }
 
+  }
  }
 #pragma omp critical
  if(nt>1){
@@ -43,6 +43,9 @@ public:
   virtual void calculate();
   virtual void prepare();
   virtual double pairing(double distance,double&dfunc,unsigned i,unsigned j)const=0;
+/// Compute pairing() on a block of n pairs, where distance2 contains the squared distances
+/// and i and j the indexes of the atoms. Can be overridden to evaluate the whole block at once
+  virtual void pairingBlock(unsigned n,const double*distance2,double*value,double*dfunc,const unsigned*i,const unsigned*j)const;
   static void registerKeywords( Keywords& keys );
 };
 
@@ -163,6 +163,27 @@ void Atoms::shareAll(){
   share(unique);
 }
 
+void Atoms::shareAtoms(const std::vector<int>& index){
+// masses and charges of all the atoms are collected at the first step
+  if(!massAndChargeOK && shareMassAndChargeOnlyAtFirstStep){
+    shareAll();
+    return;
+  }
+  std::set<AtomNumber> unique;
+  if(dd && shuffledAtoms>0)
+    for(unsigned i=0;i<index.size();i++) unique.insert(unique.end(),AtomNumber::index(index[i]));
+  atomsNeeded=true;
+  share(unique);
+}
+
+void Atoms::getNeededAtoms(std::vector<int>& index)const{
+  std::set<AtomNumber> unique;
+  for(unsigned i=0;i<actions.size();i++) if(actions[i]->isActive())
+    unique.insert(actions[i]->getUnique().begin(),actions[i]->getUnique().end());
+  index.resize(0);
+  for(const auto & p : unique) if(int(p.index())<natoms) index.push_back(p.index());
+}
+
 void Atoms::share(const std::set<AtomNumber>& unique){
   plumed_assert( positionsHaveBeenSet==3 && massesHaveBeenSet );
   virial.zero();
@@ -296,9 +317,10 @@ void Atoms::updateForces(){
   plumed_assert( forcesHaveBeenSet==3 );
   if(forceOnEnergy*forceOnEnergy>epsilon){
      double alpha=1.0-forceOnEnergy;
-     mdatoms->rescaleForces(gatindex,alpha);
+     mdatoms->updateForces(gatindex,forces,alpha);
+  } else {
+     mdatoms->updateForces(gatindex,forces);
   }
-  mdatoms->updateForces(gatindex,forces);
   if( !plumed.novirial && dd.Get_rank()==0 ){
       plumed_assert( virialHasBeenSet );
       mdatoms->updateVirial(virial);
@@ -482,16 +504,20 @@ void Atoms::removeGroup(const std::string&name){
   groups.erase(name);
 }
 
-void Atoms::writeBinary(std::ostream&o)const{
-  o.write(reinterpret_cast<const char*>(&positions[0][0]),natoms*3*sizeof(double));
-  o.write(reinterpret_cast<const char*>(&box(0,0)),9*sizeof(double));
-  o.write(reinterpret_cast<const char*>(&energy),sizeof(double));
+void Atoms::writeBinary(const std::vector<int>&index,std::vector<double>&buffer)const{
+  buffer.resize(3*index.size()+10);
+  unsigned k=0;
+  for(unsigned i=0;i<index.size();i++) for(unsigned j=0;j<3;j++) buffer[k++]=positions[index[i]][j];
+  for(unsigned i=0;i<3;i++) for(unsigned j=0;j<3;j++) buffer[k++]=box(i,j);
+  buffer[k]=energy;
 }
 
-void Atoms::readBinary(std::istream&i){
-  i.read(reinterpret_cast<char*>(&positions[0][0]),natoms*3*sizeof(double));
-  i.read(reinterpret_cast<char*>(&box(0,0)),9*sizeof(double));
-  i.read(reinterpret_cast<char*>(&energy),sizeof(double));
+void Atoms::readBinary(const std::vector<int>&index,const std::vector<double>&buffer){
+  plumed_assert(buffer.size()==3*index.size()+10);
+  unsigned k=0;
+  for(unsigned i=0;i<index.size();i++) for(unsigned j=0;j<3;j++) positions[index[i]][j]=buffer[k++];
+  for(unsigned i=0;i<3;i++) for(unsigned j=0;j<3;j++) box(i,j)=buffer[k++];
+  energy=buffer[k];
   pbc.setBox(box);
 }
 
@@ -140,6 +140,10 @@ public:
 
   void share();
   void shareAll();
+/// Share only the atoms in the list (sorted indexes)
+  void shareAtoms(const std::vector<int>&);
+/// Get the sorted list of the atoms required by the active actions
+  void getNeededAtoms(std::vector<int>&)const;
   void wait();
   void updateForces();
 
@@ -214,8 +218,10 @@ public:
   bool isVirtualAtom(AtomNumber)const;
   void insertGroup(const std::string&name,const std::vector<AtomNumber>&a);
   void removeGroup(const std::string&name);
-  void writeBinary(std::ostream&)const;
-  void readBinary(std::istream&);
+/// Pack the positions of the atoms in the list, the box and the energy in a buffer
+  void writeBinary(const std::vector<int>&,std::vector<double>&)const;
+/// Unpack the positions of the atoms in the list, the box and the energy from a buffer
+  void readBinary(const std::vector<int>&,const std::vector<double>&);
   double getKBoltzmann()const;
   double getMDKBoltzmann()const;
   bool usingNaturalUnits()const;
@@ -24,7 +24,7 @@
 #include "Atoms.h"
 #include "tools/Tools.h"
 #include "tools/Communicator.h"
-#include <sstream>
+#include <algorithm>
 #include <unordered_map>
 
 #include "GREXEnum.inc"
@@ -192,26 +192,41 @@ void GREX::cmd(const string&key,void*val){
 void GREX::savePositions(){
   plumedMain.prepareDependencies();
   plumedMain.resetActive(true);
-  atoms.shareAll();
+// only the atoms needed by at least one of the replicas are exchanged
+  atoms.getNeededAtoms(neededAtoms);
+  int nexchanged=0;
+  if(intracomm.Get_rank()==0){
+    int n=neededAtoms.size();
+    counts.resize(intercomm.Get_size());
+    displs.resize(intercomm.Get_size());
+    intercomm.Allgather(n,counts);
+    displs[0]=0;
+    for(unsigned i=1;i<counts.size();i++) displs[i]=displs[i-1]+counts[i-1];
+    allNeededAtoms.resize(displs.back()+counts.back());
+    if(allNeededAtoms.size()>0) intercomm.Allgatherv(neededAtoms.data(),n,&allNeededAtoms[0],&counts[0],&displs[0]);
+    std::sort(allNeededAtoms.begin(),allNeededAtoms.end());
+    exchangedAtoms.assign(allNeededAtoms.begin(),std::unique(allNeededAtoms.begin(),allNeededAtoms.end()));
+    nexchanged=exchangedAtoms.size();
+  }
+  intracomm.Bcast(nexchanged,0);
+  exchangedAtoms.resize(nexchanged);
+  if(nexchanged>0) intracomm.Bcast(exchangedAtoms,0);
+  atoms.shareAtoms(exchangedAtoms);
   plumedMain.waitData();
-  ostringstream o;
-  atoms.writeBinary(o);
-  buffer=o.str();
+  atoms.writeBinary(exchangedAtoms,buffer);
 }
 
 void GREX::calculate(){
 //fprintf(stderr,"CALCULATE %d %d\n",intercomm.Get_rank(),partner);
-  unsigned nn=buffer.size();
-  vector<char> rbuf(nn);
+  rbuffer.resize(buffer.size());
   localDeltaBias=-plumedMain.getBias();
   if(intracomm.Get_rank()==0){
     Communicator::Request req=intercomm.Isend(buffer,partner,1066);
-    intercomm.Recv(rbuf,partner,1066);
+    intercomm.Recv(rbuffer,partner,1066);
     req.wait();
   }
-  intracomm.Bcast(rbuf,0);
-  istringstream i(string(&rbuf[0],rbuf.size()));
-  atoms.readBinary(i);
+  intracomm.Bcast(rbuffer,0);
+  atoms.readBinary(exchangedAtoms,rbuffer);
   plumedMain.setExchangeStep(true);
   plumedMain.prepareDependencies();
   plumedMain.justCalculate();
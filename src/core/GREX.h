@@ -46,7 +46,15 @@ class GREX:
   double localUNow;
   double localUSwap;
   std::vector<double> allDeltaBias;
-  std::string buffer;
+/// Atoms needed by this replica and atoms needed by any replica (these are exchanged)
+  std::vector<int> neededAtoms;
+  std::vector<int> exchangedAtoms;
+  std::vector<int> allNeededAtoms;
+  std::vector<int> counts;
+  std::vector<int> displs;
+/// Packed coordinates of this replica and of the partner
+  std::vector<double> buffer;
+  std::vector<double> rbuffer;
   int myreplica;
 public:
   explicit GREX(PlumedMain&);
@@ -76,6 +76,7 @@ public:
   void getCharges(const vector<int>&index,vector<double>&)const;
   void updateVirial(const Tensor&)const;
   void updateForces(const vector<int>&index,const vector<Vector>&);
+  void updateForces(const vector<int>&index,const vector<Vector>&,double factor);
   void rescaleForces(const vector<int>&index,double factor);
   unsigned  getRealPrecision()const;
 };
@@ -104,7 +105,9 @@ void MDAtomsTyped<T>::getBox(Tensor&box)const{
 
 template <class T>
 void MDAtomsTyped<T>::getPositions(const vector<int>&index,vector<Vector>&positions)const{
-// cannot be parallelized with omp because access to positions is not ordered
+// index does not contain duplicates, so that different threads always write to different atoms.
+// the MD arrays are read contiguously and each thread gets a contiguous chunk of them
+  #pragma omp parallel for num_threads(OpenMP::getGoodNumThreads(px,stride*index.size()))
   for(unsigned i=0;i<index.size();++i){
     positions[index[i]][0]=px[stride*i]*scalep;
     positions[index[i]][1]=py[stride*i]*scalep;
@@ -136,14 +139,14 @@ void MDAtomsTyped<T>::getLocalPositions(vector<Vector>&positions)const{
 
 template <class T>
 void MDAtomsTyped<T>::getMasses(const vector<int>&index,vector<double>&masses)const{
-  if(m) for(unsigned i=0;i<index.size();++i) masses[index[i]]=scalem*m[i];
-  else  for(unsigned i=0;i<index.size();++i) masses[index[i]]=0.0;
+  #pragma omp parallel for num_threads(OpenMP::getGoodNumThreads(masses))
+  for(unsigned i=0;i<index.size();++i) masses[index[i]]=(m ? scalem*m[i] : 0.0);
 }
 
 template <class T>
 void MDAtomsTyped<T>::getCharges(const vector<int>&index,vector<double>&charges)const{
-  if(c) for(unsigned i=0;i<index.size();++i) charges[index[i]]=scalec*c[i];
-  else  for(unsigned i=0;i<index.size();++i) charges[index[i]]=0.0;
+  #pragma omp parallel for num_threads(OpenMP::getGoodNumThreads(charges))
+  for(unsigned i=0;i<index.size();++i) charges[index[i]]=(c ? scalec*c[i] : 0.0);
 }
 
 template <class T>
@@ -161,6 +164,18 @@ void MDAtomsTyped<T>::updateForces(const vector<int>&index,const vector<Vector>&
   }
 }
 
+template <class T>
+void MDAtomsTyped<T>::updateForces(const vector<int>&index,const vector<Vector>&forces,double factor){
+  if(virial) for(unsigned i=0;i<3;i++)for(unsigned j=0;j<3;j++) virial[3*i+j]*=T(factor);
+  const T f=T(factor);
+  #pragma omp parallel for num_threads(OpenMP::getGoodNumThreads(fx,stride*index.size()))
+  for(unsigned i=0;i<index.size();++i){
+    fx[stride*i]=fx[stride*i]*f+scalef*T(forces[index[i]][0]);
+    fy[stride*i]=fy[stride*i]*f+scalef*T(forces[index[i]][1]);
+    fz[stride*i]=fz[stride*i]*f+scalef*T(forces[index[i]][2]);
+  }
+}
+
 template <class T>
 void MDAtomsTyped<T>::rescaleForces(const vector<int>&index,double factor){
   if(virial) for(unsigned i=0;i<3;i++)for(unsigned j=0;j<3;j++) virial[3*i+j]*=T(factor);
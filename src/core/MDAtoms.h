@@ -98,6 +98,9 @@ public:
 /// Increment the force on selected atoms.
 /// The operation is done in such a way that f[index[i]] is added to the force on atom i
   virtual void updateForces(const std::vector<int>&index,const std::vector<Vector>&f)=0;
+/// Rescale all the forces, including the virial, and increment the force on selected atoms.
+/// Same as rescaleForces() followed by updateForces(), but done in a single pass on the forces
+  virtual void updateForces(const std::vector<int>&index,const std::vector<Vector>&f,double factor)=0;
 /// Rescale all the forces, including the virial.
 /// It is applied to all atoms with local index going from 0 to index.size()-1
   virtual void rescaleForces(const std::vector<int>&index,double factor)=0;
@@ -36,11 +36,13 @@
 #include "tools/DLLoader.h"
 #include "tools/Exception.h"
 #include "tools/IFile.h"
+#include "tools/OFile.h"
 #include "tools/Log.h"
 #include "tools/OpenMP.h"
 #include "tools/Tools.h"
 #include "tools/Stopwatch.h"
 #include <cstdlib>
+#include <sstream>
 #include <cstring>
 #include <set>
 #include <unordered_map>
@@ -96,6 +98,16 @@ PlumedMain::~PlumedMain(){
   stopwatch.start();
   stopwatch.stop();
   if(initialized) log<<stopwatch;
+  if(initialized && timersFile.length()>0){
+    std::ostringstream oss;
+    if(Tools::extension(timersFile)=="json") stopwatch.writeJSON(oss);
+    else stopwatch.writeCSV(oss);
+    OFile ofile;
+    ofile.link(*this);
+    ofile.open(timersFile);
+    ofile<<oss.str();
+    ofile.close();
+  }
   delete &exchangePatterns;
   delete &actionSet;
   delete &citations;
@@ -652,16 +664,12 @@ void PlumedMain::justCalculate(){
   bias=0.0;
   work=0.0;
 
+  if(detailedTimers) setupDetailedTimers();
   int iaction=0;
 // calculate the active actions in order (assuming *backward* dependence)
   for(const auto & p : actionSet){
     if(p->isActive()){
-      std::string actionNumberLabel;
-      if(detailedTimers){
-        Tools::convert(iaction,actionNumberLabel);
-        actionNumberLabel="4A "+actionNumberLabel+" "+p->getLabel();
-        stopwatch.start(actionNumberLabel);
-      }
+      if(detailedTimers) stopwatch.start(forwardTimers[iaction]);
       ActionWithValue*av=dynamic_cast<ActionWithValue*>(p);
       ActionAtomistic*aa=dynamic_cast<ActionAtomistic*>(p);
       {
@@ -680,13 +688,28 @@ void PlumedMain::justCalculate(){
       if(av)av->setGradientsIfNeeded();	
       ActionWithVirtualAtom*avv=dynamic_cast<ActionWithVirtualAtom*>(p);
       if(avv)avv->setGradientsIfNeeded();	
-      if(detailedTimers) stopwatch.stop(actionNumberLabel);
+      if(detailedTimers) stopwatch.stop(forwardTimers[iaction]);
     }
     iaction++;
   }
   stopwatch.stop("4 Calculating (forward loop)");
 }
 
+void PlumedMain::setupDetailedTimers(){
+  if(forwardTimers.size()==actionSet.size()) return;
+  forwardTimers.resize(actionSet.size());
+  backwardTimers.resize(actionSet.size());
+  updateTimers.resize(actionSet.size());
+  for(unsigned i=0;i<actionSet.size();i++){
+    std::string num;
+    Tools::convert(i,num);
+    forwardTimers[i]=stopwatch.getHandle("4A "+num+" "+actionSet[i]->getLabel());
+    updateTimers[i]=stopwatch.getHandle("6A "+num+" "+actionSet[i]->getLabel());
+// the backward loop goes through the actions in reverse order
+    backwardTimers[i]=stopwatch.getHandle("5A "+num+" "+actionSet[actionSet.size()-1-i]->getLabel());
+  }
+}
+
 void PlumedMain::justApply(){
   backwardPropagate();
   update();
@@ -694,6 +717,7 @@ void PlumedMain::justApply(){
   
 void PlumedMain::backwardPropagate(){
   if(!active)return;
+  if(detailedTimers) setupDetailedTimers();
   int iaction=0;
   stopwatch.start("5 Applying (backward loop)");
 // apply them in reverse order
@@ -701,19 +725,14 @@ void PlumedMain::backwardPropagate(){
     const auto & p(*pp);
     if(p->isActive()){
 
-      std::string actionNumberLabel;
-      if(detailedTimers){
-        Tools::convert(iaction,actionNumberLabel);
-        actionNumberLabel="5A "+actionNumberLabel+" "+p->getLabel();
-        stopwatch.start(actionNumberLabel);
-      }
+      if(detailedTimers) stopwatch.start(backwardTimers[iaction]);
 
       p->apply();
       ActionAtomistic*a=dynamic_cast<ActionAtomistic*>(p);
 // still ActionAtomistic has a special treatment, since they may need to add forces on atoms
       if(a) a->applyForces();
 
-      if(detailedTimers) stopwatch.stop(actionNumberLabel);
+      if(detailedTimers) stopwatch.stop(backwardTimers[iaction]);
     }
     iaction++;
   }
@@ -729,11 +748,18 @@ void PlumedMain::update(){
   if(!active)return;
 
   stopwatch.start("6 Update");
+  if(detailedTimers) setupDetailedTimers();
 // update step (for statistics, etc)
   updateFlags.push(true);
+  int iaction=0;
   for(const auto & p : actionSet){
     p->beforeUpdate();
-    if(p->isActive() && p->checkUpdate() && updateFlagsTop()) p->update();
+    if(p->isActive() && p->checkUpdate() && updateFlagsTop()){
+      if(detailedTimers) stopwatch.start(updateTimers[iaction]);
+      p->update();
+      if(detailedTimers) stopwatch.stop(updateTimers[iaction]);
+    }
+    iaction++;
   }
   while(!updateFlags.empty()) updateFlags.pop();
   if(!updateFlags.empty()) plumed_merror("non matching changes in the update flags");
@@ -146,6 +146,14 @@ private:
 /// Store information used in class \ref generic::UpdateIf
   std::stack<bool> updateFlags;
 
+/// Handles of the detailed timers of each action in the forward, backward and update loops
+  std::vector<unsigned> forwardTimers;
+  std::vector<unsigned> backwardTimers;
+  std::vector<unsigned> updateTimers;
+
+/// Register the detailed timers, so that no label has to be built during the calculation
+  void setupDetailedTimers();
+
 public:
 /// Flag to switch off virial calculation (for debug and MD codes with no barostat)
   bool novirial;
@@ -153,6 +161,9 @@ public:
 /// Flag to switch on detailed timers
   bool detailedTimers;
 
+/// File where all the timers are written at the end of the calculation (CSV, or JSON if the extension is json)
+  std::string timersFile;
+
 /// Add a citation, returning a string containing the reference number, something like "[10]"
   std::string cite(const std::string&);
 
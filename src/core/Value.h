@@ -129,10 +129,14 @@ public:
   void clearInputForce();
 /// Add some force on this value
   void  addForce(double f);
+/// Check if some force was added on this value
+  bool wasForced() const ;
 /// Get the value of the force on this colvar
   double getForce() const ;
 /// Apply the forces to the derivatives using the chain rule (if there are no forces this routine returns false)
   bool applyForce( std::vector<double>& forces ) const ;
+/// Add the forces on the derivatives to an array using the chain rule (if there are no forces this routine returns false)
+  bool accumulateForce( std::vector<double>& forces ) const ;
 /// Calculate the difference between the instantaneous value of the function and some other point: other_point-inst_val
   double difference(double)const;
 /// Calculate the difference between two values of this function: d2 -d1 
@@ -273,6 +277,11 @@ void Value::addForce(double f){
   inputForce+=f;
 }
 
+inline
+bool Value::wasForced() const {
+  return hasForce;
+}
+
 inline
 double Value::getForce() const {
   return inputForce;
@@ -23,6 +23,8 @@
 #include "ActionRegister.h"
 #include "core/PlumedMain.h"
 #include "core/Atoms.h"
+#include <algorithm>
+#include <cmath>
 
 using namespace std;
 
@@ -63,6 +65,13 @@ class Ensemble :
   double   kbt;
   double   moment;
   double   power;
+  // shift of the biases used to compute the weights summed over replicas
+  double   bias_shift;
+  // buffer with all the quantities summed over replicas
+  vector<double> buffer;
+  // weights of the replicas
+  vector<double> bias;
+  void     fillBuffer(const double w);
 public:
   explicit Ensemble(const ActionOptions&);
   void     calculate();
@@ -92,7 +101,8 @@ do_central(false),
 do_powers(false),
 kbt(-1.0),
 moment(0),
-power(0)
+power(0),
+bias_shift(0.0)
 {
   parseFlag("REWEIGHT", do_reweight); 
   double temp=0.0;
@@ -152,25 +162,61 @@ power(0)
   if(do_powers)                log.printf("  calculating the %lf power of the mean (and moment)\n", power);
 }
 
+void Ensemble::fillBuffer(const double w){
+  const unsigned nb = do_reweight ? ens_dim : 0;
+  for(unsigned i=0;i<narg;++i) buffer[nb+i] = w*getArgument(i);
+  if(do_moments&&!do_central) {
+    for(unsigned i=0;i<narg;++i) buffer[nb+narg+i] = w*pow(getArgument(i),moment-1)*getArgument(i);
+  }
+  if(do_reweight) buffer[buffer.size()-1] = w;
+}
+
 void Ensemble::calculate(){
   double norm = 0.0;
   double fact = 0.0;
 
+  // All the quantities summed over replicas are packed in a single buffer:
+  // the biases (with REWEIGHT), the weighted arguments, their standard moments
+  // and the sum of the weights (with REWEIGHT). The buffer is summed over
+  // replicas by the master and then broadcast inside the replica.
+  // With REWEIGHT the weights exp((bias-bias_shift)/kbt) use the largest
+  // bias of the previous step as shift, so that they can be summed together
+  // with the biases.
+  const unsigned nb = do_reweight ? ens_dim : 0;
+  const unsigned nbuf = nb + ((do_moments&&!do_central) ? 2*narg : narg) + (do_reweight ? 1 : 0);
+  buffer.assign(nbuf,0.0);
+  if(master) {
+    if(do_reweight) {
+      buffer[my_repl] = getArgument(narg);
+      fillBuffer(exp((getArgument(narg)-bias_shift)/kbt));
+    } else fillBuffer(1.0/static_cast<double>(ens_dim));
+    if(ens_dim>1) multi_sim_comm.Sum(&buffer[0], nbuf);
+  }
+  comm.Bcast(&buffer[0], nbuf, 0);
+
   // calculate the weights either from BIAS 
+  double inv_wsum = 1.0;
   if(do_reweight){
-    vector<double> bias;
-    bias.resize(ens_dim);
-    if(master){
-      bias[my_repl] = getArgument(narg); 
-      if(ens_dim>1) multi_sim_comm.Sum(&bias[0], ens_dim);  
-    }
-    comm.Sum(&bias[0], ens_dim);
+    bias.assign(buffer.begin(), buffer.begin()+ens_dim);
     const double maxbias = *(std::max_element(bias.begin(), bias.end()));
     for(unsigned i=0; i<ens_dim; ++i){
       bias[i] = exp((bias[i]-maxbias)/kbt); 
       norm += bias[i];
     }
     fact = bias[my_repl]/norm;
+    // if the shift is too far from the largest bias the weights may
+    // overflow or underflow, so they are summed again with the new shift
+    if(std::abs(maxbias-bias_shift)/kbt>300.0) {
+      bias_shift = maxbias;
+      std::fill(buffer.begin()+nb, buffer.end(), 0.0);
+      if(master) {
+        fillBuffer(exp((getArgument(narg)-bias_shift)/kbt));
+        if(ens_dim>1) multi_sim_comm.Sum(&buffer[nb], nbuf-nb);
+      }
+      comm.Bcast(&buffer[nb], nbuf-nb, 0);
+    }
+    bias_shift = maxbias;
+    inv_wsum = 1.0/buffer[nbuf-1];
   // or arithmetic ones
   } else {
     norm = static_cast<double>(ens_dim); 
@@ -181,34 +227,22 @@ void Ensemble::calculate(){
 
   vector<double> mean(narg);
   vector<double> dmean(narg,fact);
-  // calculate the mean 
-  if(master) {
-    for(unsigned i=0;i<narg;++i) mean[i] = fact*getArgument(i); 
-    if(ens_dim>1) multi_sim_comm.Sum(&mean[0], narg);
-  }
-  comm.Sum(&mean[0], narg);
+  // the mean 
+  for(unsigned i=0;i<narg;++i) mean[i] = inv_wsum*buffer[nb+i];
 
   vector<double> v_moment, dv_moment;
   // calculate other moments
   if(do_moments) {
     v_moment.resize(narg);
     dv_moment.resize(narg);
-    // standard moment
+    // standard moment, already summed together with the mean
     if(!do_central) {
-      if(master) {
-        for(unsigned i=0;i<narg;++i) { 
-          const double tmp = fact*pow(getArgument(i),moment-1);
-          v_moment[i]      = tmp*getArgument(i);
-          dv_moment[i]     = moment*tmp;
-        }
-        if(ens_dim>1) multi_sim_comm.Sum(&v_moment[0], narg);
-      } else {
-        for(unsigned i=0;i<narg;++i) {
-          const double tmp = fact*pow(getArgument(i),moment-1);
-          dv_moment[i]     = moment*tmp;
-        }
+      for(unsigned i=0;i<narg;++i) {
+        const double tmp = fact*pow(getArgument(i),moment-1);
+        v_moment[i]      = inv_wsum*buffer[nb+narg+i];
+        dv_moment[i]     = moment*tmp;
       }
-    // central moment
+    // central moment, this needs the mean and is summed separately
     } else {
       if(master) {
         for(unsigned i=0;i<narg;++i) { 
@@ -223,8 +257,8 @@ void Ensemble::calculate(){
           dv_moment[i]     = moment*tmp*(fact-fact/norm);
         }
       }
+      comm.Bcast(&v_moment[0], narg, 0);
     }
-    comm.Sum(&v_moment[0], narg);
   }
 
   // calculate powers of moments
@@ -68,34 +68,44 @@ void Function::apply()
   const unsigned ncp=getNumberOfComponents();
   const unsigned cgs=comm.Get_size();
 
-  vector<double> f(noa,0.0);
+// Only the components with a force are visited. In chains of functions
+// (e.g. COMBINE -> MATHEVAL -> RESTRAINT) most functions have a single forced
+// component or none at all, in which case nothing else is done here
+  forcedComponents.clear();
+  for(unsigned i=0;i<ncp;++i) if(getPntrToComponent(i)->wasForced()) forcedComponents.push_back(i);
+  const unsigned nforced=forcedComponents.size();
+  if(nforced==0) return;
+
+  forcesToApply.assign(noa,0.0);
 
   unsigned stride=1;
   unsigned rank=0;
-  if(ncp>4*cgs) {
-    stride=comm.Get_size();
+  if(nforced>4*cgs) {
+    stride=cgs;
     rank=comm.Get_rank();
   }
 
-  unsigned at_least_one_forced=0;
-  #pragma omp parallel num_threads(OpenMP::getNumThreads()) shared(f)
-  {
-    vector<double> omp_f(noa,0.0);
-    vector<double> forces(noa);
-    #pragma omp for reduction( + : at_least_one_forced)
-    for(unsigned i=rank;i<ncp;i+=stride) {
-      if(getPntrToComponent(i)->applyForce(forces)) {
-        at_least_one_forced+=1;
-        for(unsigned j=0;j<noa;j++) omp_f[j]+=forces[j]; 
-      }
+  unsigned nt=OpenMP::getNumThreads();
+  if(nt*10>nforced) nt=nforced/10;
+  if(nt==0) nt=1;
+
+// Forces times derivatives are accumulated directly, without a temporary array for each component
+  if(nt==1) {
+    for(unsigned i=rank;i<nforced;i+=stride) getPntrToComponent(forcedComponents[i])->accumulateForce(forcesToApply);
+  } else {
+    #pragma omp parallel num_threads(nt)
+    {
+      vector<double> omp_f(noa,0.0);
+      #pragma omp for
+      for(unsigned i=rank;i<nforced;i+=stride) getPntrToComponent(forcedComponents[i])->accumulateForce(omp_f);
+      #pragma omp critical
+      for(unsigned j=0;j<noa;j++) forcesToApply[j]+=omp_f[j];
     }
-    #pragma omp critical
-    for(unsigned j=0;j<noa;j++) f[j]+=omp_f[j]; 
   }
 
-  if(noa>0&&ncp>4*cgs) { comm.Sum(&f[0],noa); comm.Sum(at_least_one_forced); }
+  if(noa>0&&nforced>4*cgs) comm.Sum(&forcesToApply[0],noa);
 
-  if(at_least_one_forced>0) for(unsigned i=0;i<noa;++i) getPntrToArgument(i)->addForce(f[i]);
+  for(unsigned i=0;i<noa;++i) getPntrToArgument(i)->addForce(forcesToApply[i]);
 }
 
 }
@@ -39,6 +39,11 @@ class Function:
   public ActionWithValue,
   public ActionWithArguments
 {
+private:
+/// The indices of the components on which a force was added in this step
+  std::vector<unsigned> forcedComponents;
+/// The forces that are added on the arguments
+  std::vector<double> forcesToApply;
 protected:
   void setDerivative(int,double);
   void setDerivative(Value*,int,double);
@@ -21,6 +21,7 @@
 +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 #include "ActionRegister.h"
 #include "Function.h"
+#include "tools/CompiledExpression.h"
 
 #ifdef __PLUMED_HAS_MATHEVAL
 #include <matheval.h>
@@ -158,6 +159,11 @@ PRINT ARG=onaxis,fromaxis
 
 \endverbatim
 
+The function is parsed and differentiated once, when the input is read.  The function and its derivatives are then
+compiled together into a list of simple instructions, so that the parts they have in common are computed only once.
+Notice that this means that the function and the derivatives are not computed by libmatheval, so that the
+results may differ slightly (e.g. in the last digits) from those obtained with previous versions of PLUMED.
+
 Notice that these equations have been used to combine \ref RMSD
 from different snapshots of a protein so as to define
 progression (S) and distance (Z) variables \cite perez2015atp.
@@ -175,7 +181,9 @@ class Matheval :
   vector<string> var;
   string func;
   vector<double> values;
-  vector<char*> names;
+/// The function and its derivatives, compiled together
+  CompiledExpression expression;
+  vector<double> results;
 public:
   explicit Matheval(const ActionOptions&);
   ~Matheval();
@@ -198,7 +206,7 @@ Action(ao),
 Function(ao),
 evaluator_deriv(getNumberOfArguments()),
 values(getNumberOfArguments()),
-names(getNumberOfArguments())
+results(getNumberOfArguments()+1)
 {
   parseVector("VAR",var);
   if(var.size()==0){
@@ -247,16 +255,16 @@ names(getNumberOfArguments())
   log.printf("  function as parsed by matheval: %s\n", evaluator_get_string(evaluator));
   log.printf("  derivatives as computed by matheval:\n");
   for(unsigned i=0;i<var.size();i++) log.printf("    %s\n",evaluator_get_string(evaluator_deriv[i]));
+
+  expression.set( func, var, true );
+  log.printf("  function and derivatives compiled into %u instructions\n", expression.getNumberOfInstructions() );
 }
 
 void Matheval::calculate(){
   for(unsigned i=0;i<getNumberOfArguments();i++) values[i]=getArgument(i);
-  for(unsigned i=0;i<getNumberOfArguments();i++) names[i]=const_cast<char*>(var[i].c_str());
-  setValue(evaluator_evaluate(evaluator,names.size(),&names[0],&values[0]));
-
-  for(unsigned i=0;i<getNumberOfArguments();i++){
-    setDerivative(i,evaluator_evaluate(evaluator_deriv[i],names.size(),&names[0],&values[0]));
-  }
+  expression.evaluate( values.data(), results.data() );
+  setValue(results[0]);
+  for(unsigned i=0;i<getNumberOfArguments();i++) setDerivative(i,results[i+1]);
 }
 
 Matheval::~Matheval(){
@@ -40,6 +40,8 @@ Can be used while debugging or optimizing plumed.
 \verbatim
 # print detailed (action-by-action) timers at the end of simulation
 DEBUG DETAILED_TIMERS
+# also write all the timers, including percentiles of the time spent in each cycle, in JSON format
+DEBUG DETAILED_TIMERS TIMERS_FILE=timers.json
 # dump every two steps which are the atoms required from the MD code
 DEBUG logRequestedAtoms STRIDE=2
 \endverbatim
@@ -72,6 +74,7 @@ void Debug::registerKeywords( Keywords& keys ){
   keys.addFlag("logRequestedAtoms",false,"write in the log which atoms have been requested at a given time");
   keys.addFlag("NOVIRIAL",false,"switch off the virial contribution for the entirity of the simulation");
   keys.addFlag("DETAILED_TIMERS",false,"switch on detailed timers");
+  keys.add("optional","TIMERS_FILE","write all the timers on this file at the end of the simulation. The file is written in JSON format if its extension is json and in CSV format otherwise");
   keys.add("optional","FILE","the name of the file on which to output these quantities");
 }
 
@@ -90,7 +93,13 @@ novirial(false){
   if(novirial) plumed.novirial=true;
   parseFlag("DETAILED_TIMERS",detailedTimers);
   if(detailedTimers) log.printf("  Detailed timing on\n");
-  plumed.detailedTimers=true;
+  if(detailedTimers) plumed.detailedTimers=true;
+  std::string timersFile;
+  parse("TIMERS_FILE",timersFile);
+  if(timersFile.length()>0){
+    log.printf("  writing timers on file %s at the end of the simulation\n",timersFile.c_str());
+    plumed.timersFile=timersFile;
+  }
   ofile.link(*this);
   std::string file;
   parse("FILE",file);
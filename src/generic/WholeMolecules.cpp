@@ -29,6 +29,7 @@
 #include "core/PlumedMain.h"
 #include "core/ActionSet.h"
 #include "core/SetupMolInfo.h"
+#include "tools/OpenMP.h"
 
 #include <vector>
 #include <string>
@@ -108,6 +109,8 @@ class WholeMolecules:
   public ActionAtomistic
 {
   vector<vector<AtomNumber> > groups;
+/// Entities are reassembled in parallel only if they do not share atoms
+  bool disjoint;
 public:
   explicit WholeMolecules(const ActionOptions&ao);
   static void registerKeywords( Keywords& keys );
@@ -134,7 +137,8 @@ void WholeMolecules::registerKeywords( Keywords& keys ){
 WholeMolecules::WholeMolecules(const ActionOptions&ao):
 Action(ao),
 ActionPilot(ao),
-ActionAtomistic(ao)
+ActionAtomistic(ao),
+disjoint(true)
 {
   vector<AtomNumber> merge;
   for(int i=0;;i++){
@@ -172,13 +176,19 @@ ActionAtomistic(ao)
   if(groups.size()==0) error("no atom found for WHOLEMOLECULES!");
 
   checkRead();
+  const unsigned nmerge=merge.size();
   Tools::removeDuplicates(merge);
+  disjoint=(merge.size()==nmerge);
   requestAtoms(merge);
   doNotRetrieve();
   doNotForce();
 }
 
 void WholeMolecules::calculate(){
+  unsigned nt=OpenMP::getNumThreads();
+  if(nt*10>groups.size()) nt=groups.size()/10;
+  if(nt==0 || !disjoint) nt=1;
+  #pragma omp parallel for num_threads(nt)
   for(unsigned i=0;i<groups.size();++i){
     for(unsigned j=0;j<groups[i].size()-1;++j){
       const Vector & first (getPosition(groups[i][j]));
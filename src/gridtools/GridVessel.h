@@ -47,17 +47,17 @@ private:
  double cube_units;
 /// This flag is used to check if the user has created a valid input 
  bool foundprint;
-/// The minimum and maximum of the grid stored as doubles
- std::vector<double> min, max;
 /// The numerical distance between adjacent grid points
  std::vector<unsigned> stride;
-/// The number of bins in each grid direction
- std::vector<unsigned> nbin;
 /// The grid point that was requested last by getGridPointCoordinates
  unsigned currentGridPoint;
 /// The forces that will be output at the end of the calculation
  std::vector<double> finalForces;
 protected:
+/// The minimum and maximum of the grid stored as doubles
+ std::vector<double> min, max;
+/// The number of bins in each grid direction
+ std::vector<unsigned> nbin;
 /// Is forced
  bool wasforced;
 /// Forces acting on grid elements
@@ -21,6 +21,7 @@
 +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 #include "HistogramOnGrid.h"
 #include "tools/KernelFunctions.h"
+#include "tools/Tools.h"
 
 namespace PLMD {
 namespace gridtools {
@@ -63,108 +64,181 @@ void HistogramOnGrid::setBounds( const std::vector<std::string>& smin, const std
       std::vector<double> point(dimension,0);
       KernelFunctions kernel( point, bandwidths, kerneltype, false, 1.0, true ); neigh_tot=1;
       nneigh=kernel.getSupport( dx ); std::vector<double> support( kernel.getContinuousSupport() );
+      kheight=kernel.getHeight();
+      if( kerneltype=="TRIANGULAR" || kerneltype=="triangular" ) kshape=triangular;
+      else if( kerneltype=="UNIFORM" || kerneltype=="uniform" ) kshape=uniform;
+      else kshape=gaussian;
+      period.resize( dimension, 0 ); invperiod.resize( dimension, 0 );
       for(unsigned i=0;i<dimension;++i){
           if( pbc[i] && 2*support[i]>getGridExtent(i) ) error("bandwidth is too large for periodic grid");
           neigh_tot *= (2*nneigh[i]+1); 
+          if( pbc[i] ){ period[i]=getGridExtent(i); invperiod[i]=1.0/period[i]; }
       } 
   } 
 }
 
-KernelFunctions* HistogramOnGrid::getKernelAndNeighbors( std::vector<double>& point, unsigned& num_neigh, std::vector<unsigned>& neighbors ) const {
+bool HistogramOnGrid::getKernelAndNeighbors( std::vector<double>& point, unsigned& num_neigh, std::vector<unsigned>& neighbors ) const {
   if( discrete ){
      plumed_assert( getType()=="flat" );
      num_neigh=1; for(unsigned i=0;i<dimension;++i) point[i] += 0.5*dx[i];
-     neighbors[0] = getIndex( point ); return NULL;
+     neighbors[0] = getIndex( point ); return false;
   } else if( getType()=="flat" ){
-     KernelFunctions* kernel = new KernelFunctions( point, bandwidths, kerneltype, false, 1.0, true ); 
-     getNeighbors( kernel->getCenter(), nneigh, num_neigh, neighbors ); 
-     return kernel;
+     // The kernel is centered on point, its shape was set up in setBounds
+     getNeighbors( point, nneigh, num_neigh, neighbors ); 
+     return true;
   } else {
      num_neigh = getNumberOfPoints(); 
      if( neighbors.size()!=getNumberOfPoints() ) neighbors.resize( getNumberOfPoints() );
      for(unsigned i=0;i<getNumberOfPoints();++i) neighbors[i]=i;
   }
-  return NULL;
+  return false;
 }
 
-std::vector<Value*> HistogramOnGrid::getVectorOfValues() const {
-  std::vector<Value*> vv;
+namespace {
+/// Workspace used when kernels are added to the grid.  Each thread has its own copy
+/// so that no memory is allocated while the histogram is accumulated.
+struct KernelScratch {
+  std::vector<double> point, xx, der, intforce;
+  std::vector<unsigned> indices, box;
+  void resize( const unsigned& dim ){
+    point.resize( dim ); xx.resize( dim ); der.resize( dim );
+    intforce.resize( 2*dim ); indices.resize( dim ); box.resize( dim );
+  }
+};
+
+KernelScratch& getKernelScratch( const unsigned& dim ){
+  static thread_local KernelScratch scratch;
+  scratch.resize( dim );
+  return scratch;
+}
+}
+
+double HistogramOnGrid::evaluateKernel( const std::vector<double>& center, const std::vector<double>& x, std::vector<double>& der ) const {
+  plumed_dbg_assert( getType()=="flat" && !discrete && center.size()==dimension && x.size()==dimension && der.size()==dimension );
+  double r2=0;
   for(unsigned i=0;i<dimension;++i){
-      vv.push_back(new Value());
-      if( pbc[i] ) vv[i]->setDomain( str_min[i], str_max[i] );
-      else vv[i]->setNotPeriodic();
+      double d=center[i]-x[i];
+      if( pbc[i] ) d=Tools::pbc( d*invperiod[i] )*period[i];
+      der[i]=-d / bandwidths[i];
+      r2+=der[i]*der[i];
+      der[i] /= bandwidths[i];
+  }
+  double kval, kderiv;
+  if( kshape==gaussian ){
+      kval=kheight*std::exp(-0.5*r2); kderiv=-kval;
+  } else {
+      double r=sqrt(r2);
+      if( kshape==triangular && r<1.0 ){
+          kval=kheight*( 1. - r );
+          // the derivative is not defined at the center of the kernel
+          kderiv=( r>0 ? -kheight / r : 0.0 );
+      } else if( kshape==uniform && r<1.0 ){
+          kval=kheight; kderiv=0.;
+      } else {
+          kval=0.; kderiv=0.;
+      }
+  }
+  for(unsigned i=0;i<dimension;++i) der[i]*=kderiv;
+  return kval;
+}
+
+void HistogramOnGrid::addKernel( const std::vector<double>& point, const double& weight, MultiValue& myvals, std::vector<double>& buffer ) const {
+  KernelScratch& ks=getKernelScratch( dimension );
+  for(unsigned i=0;i<2*dimension;++i) ks.intforce[i]=0.0;
+  // Index of the grid point at the bottom left of the support box
+  for(unsigned i=0;i<dimension;++i){ ks.indices[i] = std::floor( (point[i]-min[i])/dx[i] ); ks.box[i]=0; }
+
+  double totwforce=0.0;
+  // Loop over the box with the first dimension running fastest.  This is the same order used in getNeighbors
+  for(unsigned ibox=0;ibox<neigh_tot;++ibox){
+      bool found=true; unsigned ineigh=0, stride=1;
+      for(unsigned i=0;i<dimension;++i){
+          int i0=ks.box[i]-nneigh[i]+ks.indices[i];
+          if( pbc[i] ){ i0%=static_cast<int>(nbin[i]); if( i0<0 ) i0+=nbin[i]; }
+          else if( i0<0 || i0>=static_cast<int>(nbin[i]) ){ found=false; break; }
+          ks.xx[i] = min[i] + dx[i]*i0;
+          ineigh += stride*i0; stride*=nbin[i];
+      }
+      // Move to the next point in the box
+      for(unsigned i=0;i<dimension;++i){
+          if( ++ks.box[i]<2*nneigh[i]+1 ) break;
+          ks.box[i]=0;
+      }
+      if( !found || inactive( ineigh ) ) continue;
+
+      double newval = evaluateKernel( point, ks.xx, ks.der );
+      accumulate( ineigh, weight, newval, ks.der, buffer );
+      if( wasForced() ){
+          accumulateForce( ineigh, weight, ks.der, ks.intforce );
+          totwforce += myvals.get( 1+dimension )*newval*forces[ineigh];
+      }
+  }
+  // Minus sign for kernel here as we are taking derivative with respect to position of center of
+  // kernel NOT derivative wrt to grid point
+  if( wasForced() ) addForces( -1, totwforce, ks.intforce, myvals, buffer );
+}
+
+void HistogramOnGrid::addVonMisesKernel( const std::vector<double>& point, const double& weight, MultiValue& myvals, std::vector<double>& buffer ) const {
+  KernelScratch& ks=getKernelScratch( dimension );
+  for(unsigned i=0;i<2*dimension;++i) ks.intforce[i]=0.0;
+
+  double totwforce=0.0;
+  for(unsigned ineigh=0;ineigh<getNumberOfPoints();++ineigh){
+      if( inactive( ineigh ) ) continue ;
+      getGridPointCoordinates( ineigh, ks.xx );
+      // Evalulate dot product
+      double dot=0; for(unsigned j=0;j<dimension;++j){ dot+=ks.xx[j]*point[j]; ks.der[j]=ks.xx[j]; }
+      // Von misses distribution for concentration parameter
+      double newval = von_misses_norm*exp( von_misses_concentration*dot );
+      // And final derivatives
+      for(unsigned j=0;j<dimension;++j) ks.der[j] *= von_misses_concentration*newval;
+      accumulate( ineigh, weight, newval, ks.der, buffer );
+      if( wasForced() ){
+          accumulateForce( ineigh, weight, ks.der, ks.intforce );
+          totwforce += myvals.get( 1+dimension )*newval*forces[ineigh];
+      }
+  }
+  if( wasForced() ) addForces( 1, totwforce, ks.intforce, myvals, buffer );
+}
+
+void HistogramOnGrid::addForces( const double& pref, const double& totwforce, const std::vector<double>& intforce, MultiValue& myvals, std::vector<double>& buffer ) const {
+  unsigned nder = getAction()->getNumberOfDerivatives();
+  unsigned gridbuf = getNumberOfBufferPoints()*getNumberOfQuantities(); 
+  for(unsigned j=0;j<dimension;++j){
+      for(unsigned k=0;k<myvals.getNumberActive();++k){
+          unsigned kder=myvals.getActiveIndex(k); 
+          buffer[ bufstart + gridbuf + kder ] += pref*intforce[j]*myvals.getDerivative( j+1, kder ); 
+      }
+  }
+  // Accumulate the sum of all the weights
+  buffer[ bufstart + gridbuf + nder ] += myvals.get(0);   
+  // Add the derivatives of the weights into the force -- this is separate loop as weights of all parts are considered together
+  for(unsigned k=0;k<myvals.getNumberActive();++k){
+      unsigned kder=myvals.getActiveIndex(k); 
+      buffer[ bufstart + gridbuf + kder ] += totwforce*myvals.getDerivative( 0, kder );
+      buffer[ bufstart + gridbuf + nder + 1 + kder ] += myvals.getDerivative( 0, kder );
   }
-  return vv;
 }
 
 void HistogramOnGrid::calculate( const unsigned& current, MultiValue& myvals, std::vector<double>& buffer, std::vector<unsigned>& der_list ) const {
   if( addOneKernelAtATime ){
      plumed_dbg_assert( myvals.getNumberOfValues()==2 && !wasforced );
-     std::vector<double> der( dimension ); 
-     for(unsigned i=0;i<dimension;++i) der[i]=myvals.getDerivative( 1, i );
-     accumulate( getAction()->getPositionInCurrentTaskList(current), myvals.get(0), myvals.get(1), der, buffer );
+     KernelScratch& ks=getKernelScratch( dimension );
+     for(unsigned i=0;i<dimension;++i) ks.der[i]=myvals.getDerivative( 1, i );
+     accumulate( getAction()->getPositionInCurrentTaskList(current), myvals.get(0), myvals.get(1), ks.der, buffer );
   } else {
      plumed_dbg_assert( myvals.getNumberOfValues()==dimension+2 );
-     std::vector<double> point( dimension ); double weight=myvals.get(0)*myvals.get( 1+dimension );
-     for(unsigned i=0;i<dimension;++i) point[i]=myvals.get( 1+i );
-
-     // Get the kernel
-     unsigned num_neigh; std::vector<unsigned> neighbors; 
-     std::vector<double> der( dimension ); 
-     KernelFunctions* kernel=getKernelAndNeighbors( point, num_neigh, neighbors );
+     KernelScratch& ks=getKernelScratch( dimension ); double weight=myvals.get(0)*myvals.get( 1+dimension );
+     for(unsigned i=0;i<dimension;++i) ks.point[i]=myvals.get( 1+i );
 
-     if( !kernel && getType()=="flat" ){
-         plumed_dbg_assert( num_neigh==1 );
-         accumulate( neighbors[0], weight, 1.0, der, buffer );
+     if( discrete ){
+         for(unsigned i=0;i<dimension;++i){ ks.point[i] += 0.5*dx[i]; ks.der[i]=0.0; }
+         getIndices( ks.point, ks.indices );
+         accumulate( getIndex( ks.indices ), weight, 1.0, ks.der, buffer );
+     } else if( getType()=="flat" ){
+         addKernel( ks.point, weight, myvals, buffer );
      } else {
-         double totwforce=0.0;
-         std::vector<double> intforce( 2*dimension, 0.0 ); 
-         std::vector<Value*> vv( getVectorOfValues() ); 
-
-         double newval; std::vector<double> xx( dimension );
-         for(unsigned i=0;i<num_neigh;++i){
-             unsigned ineigh=neighbors[i];
-             if( inactive( ineigh ) ) continue ;
-             getGridPointCoordinates( ineigh, xx );
-             if( kernel ){
-                  for(unsigned j=0;j<dimension;++j) vv[j]->set(xx[j]);
-                  newval = kernel->evaluate( vv, der, true ); 
-             } else {
-                  // Evalulate dot product
-                  double dot=0; for(unsigned j=0;j<dimension;++j){ dot+=xx[j]*point[j]; der[j]=xx[j]; }
-                  // Von misses distribution for concentration parameter
-                  newval = von_misses_norm*exp( von_misses_concentration*dot );
-                  // And final derivatives
-                  for(unsigned j=0;j<dimension;++j) der[j] *= von_misses_concentration*newval;
-             } 
-             accumulate( ineigh, weight, newval, der, buffer );
-             if( wasForced() ){  
-                 accumulateForce( ineigh, weight, der, intforce ); 
-                 totwforce += myvals.get( 1+dimension )*newval*forces[ineigh];
-             } 
-         }
-         if( wasForced() ){
-             // Minus sign for kernel here as we are taking derivative with respect to position of center of 
-             // kernel NOT derivative wrt to grid point
-             double pref = 1; if( kernel ) pref = -1;
-             unsigned nder = getAction()->getNumberOfDerivatives();
-             unsigned gridbuf = getNumberOfBufferPoints()*getNumberOfQuantities(); 
-             for(unsigned j=0;j<dimension;++j){
-                 for(unsigned k=0;k<myvals.getNumberActive();++k){
-                     unsigned kder=myvals.getActiveIndex(k); 
-                     buffer[ bufstart + gridbuf + kder ] += pref*intforce[j]*myvals.getDerivative( j+1, kder ); 
-                 }
-             }
-             // Accumulate the sum of all the weights
-             buffer[ bufstart + gridbuf + nder ] += myvals.get(0);   
-             // Add the derivatives of the weights into the force -- this is separate loop as weights of all parts are considered together
-             for(unsigned k=0;k<myvals.getNumberActive();++k){
-                 unsigned kder=myvals.getActiveIndex(k); 
-                 buffer[ bufstart + gridbuf + kder ] += totwforce*myvals.getDerivative( 0, kder );
-                 buffer[ bufstart + gridbuf + nder + 1 + kder ] += myvals.getDerivative( 0, kder );
-             }
-         }
-         delete kernel; for(unsigned i=0;i<dimension;++i) delete vv[i];
+         addVonMisesKernel( ks.point, weight, myvals, buffer );
      }
   }
 }
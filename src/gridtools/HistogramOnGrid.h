@@ -37,6 +37,16 @@ private:
   std::string kerneltype;
   std::vector<double> bandwidths;
   std::vector<unsigned> nneigh;
+/// The shape of the kernel and the parameters needed to evaluate it, computed once in setBounds
+  enum {gaussian,triangular,uniform} kshape;
+  double kheight;
+  std::vector<double> period, invperiod;
+/// Add a kernel centered at point to all the grid points within its support
+  void addKernel( const std::vector<double>& point, const double& weight, MultiValue& myvals, std::vector<double>& buffer ) const ;
+/// Add a von Mises-Fisher kernel centered at point to all the points of a spherical grid
+  void addVonMisesKernel( const std::vector<double>& point, const double& weight, MultiValue& myvals, std::vector<double>& buffer ) const ;
+/// Add the derivatives of the integrated forces on the grid to the buffer
+  void addForces( const double& pref, const double& totwforce, const std::vector<double>& intforce, MultiValue& myvals, std::vector<double>& buffer ) const ;
 protected:
   bool discrete;
 public:
@@ -51,8 +61,10 @@ public:
   virtual void accumulate( const unsigned& ipoint, const double& weight, const double& dens, const std::vector<double>& der, std::vector<double>& buffer ) const ;
   virtual void accumulateForce( const unsigned& ipoint, const double& weight, const std::vector<double>& der, std::vector<double>& intforce ) const ;
   unsigned getNumberOfBufferPoints() const ;
-  KernelFunctions* getKernelAndNeighbors( std::vector<double>& point, unsigned& num_neigh, std::vector<unsigned>& neighbors ) const;
-  std::vector<Value*> getVectorOfValues() const ;
+/// Get the grid points affected by a kernel centered at point. Returns true if the kernel has to be evaluated with evaluateKernel
+  bool getKernelAndNeighbors( std::vector<double>& point, unsigned& num_neigh, std::vector<unsigned>& neighbors ) const;
+/// Evaluate the kernel centered at center and its derivatives at the grid point with coordinates x
+  double evaluateKernel( const std::vector<double>& center, const std::vector<double>& x, std::vector<double>& der ) const ;
   void addOneKernelEachTimeOnly(){ addOneKernelAtATime=true; }
   virtual void getFinalForces( const std::vector<double>& buffer, std::vector<double>& finalForces );
   bool noDiscreteKernels() const ;
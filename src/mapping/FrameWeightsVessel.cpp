@@ -0,0 +1,55 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2016 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#include "FrameWeightsVessel.h"
+
+namespace PLMD {
+namespace mapping {
+
+FrameWeightsVessel::FrameWeightsVessel( const vesselbase::VesselOptions& da ):
+Vessel(da),
+nframes(0)
+{
+}
+
+std::string FrameWeightsVessel::description(){
+  return "";
+}
+
+void FrameWeightsVessel::resize(){
+  nframes=getAction()->getFullNumberOfTasks();
+  resizeBuffer( nframes ); weights.assign( nframes, 0.0 );
+}
+
+void FrameWeightsVessel::calculate( const unsigned& current, MultiValue& myvals, std::vector<double>& buffer, std::vector<unsigned>& der_list ) const {
+  buffer[bufstart+current]=myvals.get(0);
+}
+
+void FrameWeightsVessel::finish( const std::vector<double>& buffer ){
+  for(unsigned i=0;i<nframes;++i) weights[i]=buffer[bufstart+i];
+}
+
+bool FrameWeightsVessel::applyForce( std::vector<double>& forces ){
+  return false;
+}
+
+}
+}
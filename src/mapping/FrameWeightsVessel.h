@@ -0,0 +1,58 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2016 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#ifndef __PLUMED_mapping_FrameWeightsVessel_h
+#define __PLUMED_mapping_FrameWeightsVessel_h
+
+#include "vesselbase/Vessel.h"
+#include <vector>
+
+namespace PLMD {
+namespace mapping {
+
+/// This vessel collects the weight of each frame in a mapping, so that
+/// the frames that do not contribute can be removed from the task list
+class FrameWeightsVessel : public vesselbase::Vessel {
+private:
+/// The number of frames
+  unsigned nframes;
+/// The weights from the last calculation
+  std::vector<double> weights;
+public:
+  explicit FrameWeightsVessel( const vesselbase::VesselOptions& da );
+  std::string description();
+  void resize();
+  void calculate( const unsigned& current, MultiValue& myvals, std::vector<double>& buffer, std::vector<unsigned>& der_list ) const ;
+  void finish( const std::vector<double>& buffer );
+  bool applyForce( std::vector<double>& forces );
+/// Get the weight of a frame.  This is zero if the frame was not computed
+  double getWeight( const unsigned& iframe ) const ;
+};
+
+inline
+double FrameWeightsVessel::getWeight( const unsigned& iframe ) const {
+  plumed_dbg_assert( iframe<nframes );
+  return weights[iframe];
+}
+
+}
+}
+#endif
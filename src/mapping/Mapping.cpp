@@ -50,7 +50,9 @@ Action(ao),
 ActionAtomistic(ao),
 ActionWithArguments(ao),
 ActionWithValue(ao),
-ActionWithVessel(ao)
+ActionWithVessel(ao),
+usebatch(false),
+batchsafe(false)
 {
   // Read the input
   std::string mtype; parse("TYPE",mtype);
@@ -105,6 +107,7 @@ ActionWithVessel(ao)
   mymap->getAtomAndArgumentRequirements( atoms, args );
   requestAtoms( atoms ); std::vector<Value*> req_args;
   interpretArgumentList( args, req_args ); requestArguments( req_args );
+  setupRMSDBatch();
   // Duplicate all frames (duplicates are used by sketch-map)
   // mymap->duplicateFrameList(); 
   // fframes.resize( 2*nfram, 0.0 ); dfframes.resize( 2*nfram, 0.0 );
@@ -184,9 +187,39 @@ void Mapping::finishPackSetup( const unsigned& ifunc, ReferenceValuePack& mypack
    }
 }
 
+void Mapping::setupRMSDBatch(){
+  std::vector<ReferenceConfiguration*>& frames( mymap->getReferenceConfigurations() );
+  if( getNumberOfArguments()>0 || getNumberOfAtoms()==0 ) return;
+  for(unsigned i=0;i<frames.size();++i){
+     if( frames[i]->getName()!=frames[0]->getName() ) return;
+     if( frames[i]->getName()!="OPTIMAL" && frames[i]->getName()!="OPTIMAL-FAST" ) return;
+     if( frames[i]->getNumberOfReferenceArguments()>0 ) return;
+     ReferenceAtoms* myat=dynamic_cast<ReferenceAtoms*>( frames[i] );
+     if( !myat || myat->getNumberOfReferencePositions()!=getNumberOfAtoms() ) return;
+     if( myat->getAlign()!=myat->getDisplace() ) return;
+     for(unsigned j=0;j<getNumberOfAtoms();++j) if( myat->getAtomIndex(j)!=j ) return;
+     if( i>0 && !rmsdbatch.sameWeights( myat->getAlign() ) ){ rmsdbatch.clear(); return; }
+     rmsdbatch.addReference( myat->getAlign(), myat->getReferencePositions() );
+  }
+  usebatch=true; batchsafe=( frames[0]->getName()=="OPTIMAL" );
+  log.printf("  distances from the %u frames are computed together\n",rmsdbatch.getNumberOfReferences() );
+}
+
+void Mapping::prepareDistanceFunctions(){
+  if( usebatch ) rmsdbatch.center( getPositions(), centeredpos );
+}
+
 double Mapping::calculateDistanceFunction( const unsigned& ifunc, ReferenceValuePack& myder, const bool& squared ) const {
   // Calculate the distance
-  double dd = mymap->calcDistanceFromConfiguration( ifunc, getPositions(), getPbc(), getArguments(), myder, squared );     
+  double dd;
+  // The batch only computes the derivatives, so the PCA option needs the per-frame calculation
+  if( usebatch && !myder.calcUsingPCAOption() ){
+      dd=rmsdbatch.calculate( ifunc, centeredpos, myder.getAtomVector(), batchsafe, squared );
+      myder.clear(); for(unsigned i=0;i<centeredpos.size();++i) myder.setAtomDerivatives( i, myder.getAtomVector()[i] );
+      if( !myder.updateComplete() ) myder.updateDynamicLists();
+  } else {
+      dd = mymap->calcDistanceFromConfiguration( ifunc, getPositions(), getPbc(), getArguments(), myder, squared );     
+  }
   // Transform distance by whatever
   double df, ff=transformHD( dd, df ); myder.scaleAllDerivatives( df );
   // And the virial
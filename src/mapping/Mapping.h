@@ -27,6 +27,7 @@
 #include "core/ActionWithArguments.h"
 #include "vesselbase/ActionWithVessel.h"
 #include "reference/PointWiseMapping.h"
+#include "tools/RMSDBatch.h"
 #include <vector>
 
 namespace PLMD {
@@ -49,6 +50,13 @@ private:
   PointWiseMapping* mymap;
 /// The forces on each of the derivatives (used in apply)
   std::vector<double> forcesToApply;
+/// The frames packed together when they are all optimal RMSD on the same atoms
+  RMSDBatch rmsdbatch;
+  bool usebatch, batchsafe;
+/// The positions with the center removed
+  std::vector<Vector> centeredpos;
+/// Check if the distances from the frames can be computed using rmsdbatch
+  void setupRMSDBatch();
 protected:
 /// The (transformed) distance from each frame
   std::vector<double> fframes;
@@ -56,6 +64,8 @@ protected:
   unsigned getNumberOfReferencePoints() const ;
 /// Finish the setup of the referenceValuePack by transfering atoms and args
   void finishPackSetup( const unsigned& ifunc, ReferenceValuePack& mypack ) const ;
+/// Do the parts of the calculation that are shared by all frames
+  void prepareDistanceFunctions();
 /// Calculate the value of the distance from the ith frame
   double calculateDistanceFunction( const unsigned& ifunc, ReferenceValuePack& myder, const bool& squared ) const ;
 /// Store the distance function
@@ -105,6 +105,18 @@ END
 The remarks in this pdb file tell PLUMED the labels that are being used to define the position in the 
 high dimensional space and the values that these arguments have at each point on the path.
 
+When the path contains many frames most of them give a negligible contribution to the sums above.
+In the example below the distances are only computed from the frames that are needed to calculate 
+the sum of \f$\exp( -\lambda R[X - X_i] )\f$ with a relative error smaller than \f$10^{-6}\f$.  The error
+is estimated at every step from the distance from the closest frame and the distances between the frames, 
+which is exact when the distance is a metric (e.g. for the OPTIMAL and EUCLIDEAN metrics).  The distances from
+all the frames are computed when this estimate is larger than NEIGH_TOL and every NEIGH_STRIDE steps.
+
+\verbatim
+p1: PATH REFERENCE=file.pdb TYPE=OPTIMAL LAMBDA=500.0 NEIGH_TOL=1e-6 NEIGH_STRIDE=100
+PRINT ARG=p1.spath,p1.zpath STRIDE=1 FILE=colvar FMT=%8.4f
+\endverbatim
+
 */
 //+ENDPLUMEDOC
 
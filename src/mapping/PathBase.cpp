@@ -21,6 +21,7 @@
 +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 #include "PathBase.h"
 #include "tools/SwitchingFunction.h"
+#include <algorithm>
 
 namespace PLMD {
 namespace mapping{
@@ -29,15 +30,34 @@ void PathBase::registerKeywords( Keywords& keys ){
   Mapping::registerKeywords( keys ); 
   keys.add("compulsory","LAMBDA","0","the value of the lambda parameter for paths");
   keys.addFlag("NOZPATH",false,"do not calculate the zpath position");
+  keys.add("optional","NEIGH_TOL","only compute the distances from the frames that are needed to calculate the sum of the weights "
+                                  "\\f$\\exp(-\\lambda R[X-X_i])\\f$ with a relative error smaller than this tolerance. "
+                                  "The error is estimated using the triangle inequality and the distances between the frames");
+  keys.add("compulsory","NEIGH_STRIDE","0","how often (in steps) the distances from all the frames are computed when NEIGH_TOL is used. "
+                                           "If this is zero they are only computed when the error could be larger than NEIGH_TOL");
 }
 
 PathBase::PathBase(const ActionOptions& ao):
 Action(ao),
-Mapping(ao)
+Mapping(ao),
+neigh_tol(0),
+neigh_stride(0),
+last_refresh(-1),
+closest_frame(0),
+frameweights(NULL)
 {
   weightHasDerivatives=true;
   bool noz; parseFlag("NOZPATH",noz);
   parse("LAMBDA",lambda);
+  parse("NEIGH_TOL",neigh_tol); parse("NEIGH_STRIDE",neigh_stride);
+  if( neigh_tol>0 ){
+     if( lambda<=0 ) error("NEIGH_TOL can only be used with a positive value of LAMBDA");
+     log.printf("  only computing the frames needed to get the sum of the weights with a relative error smaller than %f\n",neigh_tol);
+     if( neigh_stride>0 ) log.printf("  distances from all the frames are computed every %u steps\n",neigh_stride);
+     vesselbase::VesselOptions da("","",0,"",this);
+     frameweights=new FrameWeightsVessel(da); addVessel( frameweights );
+     unsigned n=getNumberOfReferencePoints(); frame_distances.assign( (n*(n-1))/2, -1.0 );
+  }
 
   // Create the list of tasks
   for(unsigned i=0;i<getNumberOfReferencePoints();++i) addTaskToList( i );
@@ -58,8 +78,85 @@ double PathBase::getLambda(){
 }
 
 void PathBase::calculate(){
+  // Center the positions once for all the frames
+  prepareDistanceFunctions();
   // Loop over all frames is now performed by ActionWithVessel
+  if( !frameweights ){ runAllTasks(); return; }
+
+  // Only the frames in the list are computed, unless the weight of the frame that
+  // was the closest at the previous step shows that the error could be too large
+  bool refresh=( last_refresh<0 || (neigh_stride>0 && getStep()-last_refresh>=neigh_stride) );
+  if( !refresh ){
+     MultiValue myvals( 2, getNumberOfDerivatives() );
+     ReferenceValuePack mypack( getNumberOfArguments(), getNumberOfAtoms(), myvals );
+     finishPackSetup( closest_frame, mypack );
+     refresh=!frameListIsValid( calculateDistanceFunction( closest_frame, mypack, true ) );
+  }
+  if( refresh ){
+     deactivateAllTasks();
+     for(unsigned i=0;i<getFullNumberOfTasks();++i) taskFlags[i]=1;
+     lockContributors();
+  }
   runAllTasks();
+  if( refresh ){ updateFrameList(); last_refresh=getStep(); return; }
+  for(unsigned i=0;i<getNumberOfReferencePoints();++i){
+     if( frameweights->getWeight(i)>frameweights->getWeight(closest_frame) ) closest_frame=i;
+  }
+}
+
+double PathBase::getFrameDistance( const unsigned& iframe, const unsigned& jframe ){
+  if( iframe==jframe ) return 0.0;
+  // Only the lower triangle is stored
+  const unsigned i=std::max( iframe, jframe ), j=std::min( iframe, jframe ), k=(i*(i-1))/2+j;
+  if( frame_distances[k]<0 ){
+     frame_distances[k]=std::sqrt( distance( getPbc(), getArguments(), getReferenceConfiguration(i), getReferenceConfiguration(j), true ) );
+  }
+  return frame_distances[k];
+}
+
+bool PathBase::frameListIsValid( const double& wclose ){
+  if( skipped_frames.size()==0 ) return true;
+  if( !(wclose>0) ) return false;
+  // By the triangle inequality the skipped frames are at least this far
+  double dclose=std::sqrt( -std::log( wclose ) / lambda ), err=0;
+  for(unsigned i=0;i<skipped_frames.size();++i){
+     double b=getFrameDistance( closest_frame, skipped_frames[i] ) - dclose;
+     if( b>0 ) err+=std::exp( -lambda*b*b ); else err+=1.0;
+  }
+  return err<=neigh_tol*wclose;
+}
+
+void PathBase::updateFrameList(){
+  const unsigned n=getNumberOfReferencePoints();
+  closest_frame=0;
+  for(unsigned i=0;i<n;++i){
+     if( frameweights->getWeight(i)>frameweights->getWeight(closest_frame) ) closest_frame=i;
+  }
+  skipped_frames.resize(0);
+  double wclose=frameweights->getWeight(closest_frame);
+  if( !(wclose>0) ) return;
+
+  // Sort the frames using the bound on their distance that is used in frameListIsValid
+  double dclose=std::sqrt( -std::log( wclose ) / lambda );
+  std::vector<std::pair<double,unsigned> > bounds( n );
+  for(unsigned i=0;i<n;++i){
+     double b=getFrameDistance( closest_frame, i ) - dclose;
+     bounds[i]=std::pair<double,unsigned>( b>0 ? b : 0.0, i );
+  }
+  std::sort( bounds.begin(), bounds.end() );
+
+  // And skip the farthest frames.  Only half of the tolerance is used here so
+  // that the list remains valid while the system moves
+  double err=0; unsigned nkeep=n;
+  while( nkeep>2 ){
+     double w=std::exp( -lambda*bounds[nkeep-1].first*bounds[nkeep-1].first );
+     if( err+w>0.5*neigh_tol*wclose ) break;
+     err+=w; nkeep--;
+  }
+  deactivateAllTasks();
+  for(unsigned i=0;i<nkeep;++i) taskFlags[bounds[i].second]=1;
+  for(unsigned i=nkeep;i<n;++i) skipped_frames.push_back( bounds[i].second );
+  lockContributors();
 }
 
 void PathBase::performTask( const unsigned& task_index, const unsigned& current, MultiValue& myvals ) const {
@@ -23,6 +23,7 @@
 #define __PLUMED_mapping_PathBase_h
 
 #include "Mapping.h"
+#include "FrameWeightsVessel.h"
 
 namespace PLMD {
 namespace mapping{
@@ -30,6 +31,25 @@ namespace mapping{
 class PathBase : public Mapping {
 private:
   double lambda;
+/// The largest relative error allowed on the sum of the weights of the frames
+  double neigh_tol;
+/// How often all the frames must be computed
+  unsigned neigh_stride;
+  long int last_refresh;
+/// The frame with the largest weight at the last step
+  unsigned closest_frame;
+/// The weights of all the frames at the last step
+  FrameWeightsVessel* frameweights;
+/// The frames that are not computed
+  std::vector<unsigned> skipped_frames;
+/// The distances between the frames (lower triangle), a negative value means it has not been computed yet
+  std::vector<double> frame_distances;
+/// Get the distance between two frames (square root of the metric)
+  double getFrameDistance( const unsigned& iframe, const unsigned& jframe );
+/// Check that the frames that are not computed give a small contribution, given the weight of the closest frame
+  bool frameListIsValid( const double& wclose );
+/// Choose the frames to compute using the weights of all the frames
+  void updateFrameList();
 public:
   static void registerKeywords( Keywords& keys );
   explicit PathBase(const ActionOptions&);
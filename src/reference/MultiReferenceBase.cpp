@@ -21,7 +21,9 @@
 +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 #include "MultiReferenceBase.h"
 #include "tools/Communicator.h"
+#include "tools/OpenMP.h"
 #include "MetricRegister.h"
+#include <algorithm>
 
 namespace PLMD {
 
@@ -92,15 +94,47 @@ void MultiReferenceBase::setWeights( const std::vector<double>& weights ){
 
 
 void MultiReferenceBase::calculateAllDistances( const Pbc& pbc, const std::vector<Value*> & vals, Communicator& comm, Matrix<double>& distances, const bool& squared ){
-  distances=0.0;
-  unsigned k=0, size=comm.Get_size(), rank=comm.Get_rank(); 
-  for(unsigned i=1;i<frames.size();++i){
-      for(unsigned j=0;j<i;++j){
-          if( (k++)%size!=rank ) continue;         
-          distances(i,j) = distances(j,i) = distance( pbc, vals, frames[i], frames[j], squared );
+  const unsigned nframes=frames.size();
+  plumed_dbg_assert( distances.nrows()==nframes && distances.ncols()==nframes );
+  if( nframes==0 ) return;
+  // The lower triangle is first stored packed at the beginning of the matrix itself, element (i,j) with j<i
+  // is in position i*(i-1)/2+j, so that only the triangle is communicated and no additional memory is needed
+  double* packed=&distances(0,0);
+  const size_t npacked=static_cast<size_t>(nframes)*(nframes-1)/2;
+  std::fill( packed, packed+npacked, 0.0 );
+  // The triangle is divided in square tiles, that are distributed over processes and threads
+  const unsigned tsize=32, ntb=(nframes+tsize-1)/tsize;
+  std::vector<unsigned> mytiles;
+  unsigned k=0, size=comm.Get_size(), rank=comm.Get_rank();
+  for(unsigned bi=0;bi<ntb;++bi){
+      for(unsigned bj=0;bj<=bi;++bj){
+          if( (k++)%size==rank ) mytiles.push_back( bi*ntb+bj );
       }
   }
-  comm.Sum( distances );
+  unsigned nt=OpenMP::getNumThreads();
+  if( nt>mytiles.size() ) nt=mytiles.size();
+  if( nt==0 ) nt=1;
+  #pragma omp parallel for schedule(dynamic) num_threads(nt)
+  for(unsigned t=0;t<mytiles.size();++t){
+      const unsigned bi=mytiles[t]/ntb, bj=mytiles[t]%ntb;
+      const unsigned iend=std::min( (bi+1)*tsize, nframes ), jend=(bj+1)*tsize;
+      for(unsigned i=bi*tsize;i<iend;++i){
+          const size_t base=static_cast<size_t>(i)*(i-1)/2;
+          for(unsigned j=bj*tsize;j<jend && j<i;++j) packed[base+j]=distance( pbc, vals, frames[i], frames[j], squared );
+      }
+  }
+  // Only the lower triangle is communicated
+  if( npacked>0 ) comm.Sum( packed, npacked );
+  // Unpack starting from the last row: row i is packed before position i*nframes, where it is moved,
+  // and after the rows that have not been moved yet
+  for(unsigned i=nframes-1;i>0;--i){
+      const size_t base=static_cast<size_t>(i)*(i-1)/2;
+      for(unsigned j=0;j<i;++j) distances(i,j)=packed[base+j];
+  }
+  for(unsigned i=0;i<nframes;++i){
+      distances(i,i)=0.0;
+      for(unsigned j=0;j<i;++j) distances(j,i)=distances(i,j);
+  }
 }
 
 }
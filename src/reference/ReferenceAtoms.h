@@ -28,6 +28,10 @@ namespace PLMD {
 
 class Pbc;
 
+namespace mapping {
+class Mapping;
+}
+
 /// \ingroup TOOLBOX
 /// In many applications (e.g. paths, fields, property maps) it is necessary to calculate
 /// the distance between two configurations.  These distances can be calculated in a variety of 
@@ -47,6 +51,7 @@ class ReferenceAtoms :
 friend class Direction;
 friend class SingleDomainRMSD;
 friend class ReferenceConfiguration;
+friend class mapping::Mapping;
 private:
 /// This flag tells us if the user has disabled checking of the input in order to
 /// do fancy paths with weird inputs
@@ -27,6 +27,7 @@
 #include "vesselbase/Vessel.h"
 #include "reference/MetricRegister.h"
 #include "reference/SingleDomainRMSD.h"
+#include <algorithm>
 
 namespace PLMD {
 namespace secondarystructure{
@@ -77,7 +78,8 @@ ActionWithVessel(ao),
 align_strands(false),
 s_cutoff2(0),
 align_atom_1(0),
-align_atom_2(0)
+align_atom_2(0),
+strand_cells(comm)
 {
   parse("TYPE",alignType);
   log.printf("  distances from secondary structure elements are calculated using %s algorithm\n",alignType.c_str() );
@@ -88,7 +90,10 @@ align_atom_2(0)
   if( keywords.exists("STRANDS_CUTOFF") ){
     double s_cutoff = 0;
     parse("STRANDS_CUTOFF",s_cutoff); align_strands=true;
-    if( s_cutoff>0) log.printf("  ignoring contributions from strands that are more than %f apart\n",s_cutoff);
+    if( s_cutoff>0){
+       log.printf("  ignoring contributions from strands that are more than %f apart\n",s_cutoff);
+       strand_cells.setCutoff( s_cutoff );
+    }
     s_cutoff2=s_cutoff*s_cutoff;
   }
 }
@@ -173,6 +178,7 @@ void SecondaryStructureRMSD::setSecondaryStructure( std::vector<Vector>& structu
   std::vector<double> align( structure.size(), 1.0 ), displace( structure.size(), 1.0 );
   references[nn]->setBoundsOnDistances( true , bondlength );  // We always use pbc
   references[nn]->setReferenceAtoms( structure, align, displace );
+  if( alignType=="OPTIMAL" || alignType=="OPTIMAL-FAST" ) rmsdbatch.addReference( align, structure );
 //  references[nn]->setNumberOfAtoms( structure.size() );
 
   // And prepare the task list
@@ -181,18 +187,88 @@ void SecondaryStructureRMSD::setSecondaryStructure( std::vector<Vector>& structu
   lockContributors(); 
 }
 
+void SecondaryStructureRMSD::setupStrandLists(){
+  // Find the atoms that are used to compute the distance between strands
+  std::vector<unsigned> strand_index( all_atoms.size(), all_atoms.size() );
+  std::vector<unsigned> first( getFullNumberOfTasks() ), second( getFullNumberOfTasks() );
+  for(unsigned i=0;i<getFullNumberOfTasks();++i){
+     unsigned a1=colvar_atoms[i][align_atom_1], a2=colvar_atoms[i][align_atom_2];
+     if( strand_index[a1]==all_atoms.size() ){ strand_index[a1]=strand_atoms.size(); strand_atoms.push_back( a1 ); }
+     if( strand_index[a2]==all_atoms.size() ){ strand_index[a2]=strand_atoms.size(); strand_atoms.push_back( a2 ); }
+     first[i]=strand_index[a1]; second[i]=strand_index[a2];
+  }
+  // And sort the tasks by the first alignment atom
+  strand_starts.assign( strand_atoms.size()+1, 0 );
+  for(unsigned i=0;i<first.size();++i) strand_starts[first[i]+1]++;
+  for(unsigned i=0;i<strand_atoms.size();++i) strand_starts[i+1]+=strand_starts[i];
+  strand_tasks.resize( first.size() );
+  std::vector<unsigned> next( strand_starts.begin(), strand_starts.end()-1 );
+  for(unsigned i=0;i<first.size();++i) strand_tasks[ next[first[i]]++ ]=std::pair<unsigned,unsigned>( second[i], i );
+  for(unsigned i=0;i<strand_atoms.size();++i) std::sort( strand_tasks.begin()+strand_starts[i], strand_tasks.begin()+strand_starts[i+1] );
+
+  strand_pos.resize( strand_atoms.size() ); strand_linked.resize( 1+strand_atoms.size() );
+  strand_ind.resize( strand_atoms.size() );
+  for(unsigned i=0;i<strand_atoms.size();++i) strand_ind[i]=i;
+}
+
+void SecondaryStructureRMSD::activateCloseStrands(){
+  if( strand_starts.size()==0 ) setupStrandLists();
+
+  // Build the link cells using the positions of the strand atoms
+  for(unsigned i=0;i<strand_atoms.size();++i) strand_pos[i]=ActionAtomistic::getPosition( strand_atoms[i] );
+  strand_cells.buildCellLists( strand_pos, strand_ind, getPbc() );
+
+  // And activate the tasks for which the two strands are close
+  deactivateAllTasks();
+  for(unsigned i=0;i<strand_atoms.size();++i){
+     if( strand_starts[i+1]==strand_starts[i] ) continue;
+     unsigned natomsper=1; strand_linked[0]=i;
+     strand_cells.retrieveNeighboringAtoms( strand_pos[i], natomsper, strand_linked );
+     for(unsigned j=1;j<natomsper;++j){
+         unsigned k=strand_linked[j];
+         if( pbcDistance( strand_pos[i], strand_pos[k] ).modulo2()>s_cutoff2 ) continue;
+         std::vector<std::pair<unsigned,unsigned> >::const_iterator t=std::lower_bound( strand_tasks.begin()+strand_starts[i], 
+                                                                                       strand_tasks.begin()+strand_starts[i+1],
+                                                                                       std::pair<unsigned,unsigned>( k, 0 ) );
+         for(;t!=strand_tasks.begin()+strand_starts[i+1] && t->first==k;++t) taskFlags[t->second]=1;
+     }
+  }
+  lockContributors();
+}
+
 void SecondaryStructureRMSD::calculate(){
+  // Only the pairs of strands that are close are computed
+  if( s_cutoff2>0 && getPbc().isSet() ) activateCloseStrands();
   runAllTasks();
 }
 
-void SecondaryStructureRMSD::performTask( const unsigned& task_index, const unsigned& current, MultiValue& myvals ) const {
-  // Retrieve the positions
-  std::vector<Vector> pos( references[0]->getNumberOfAtoms() );
-  const unsigned n=pos.size();
-  for(unsigned i=0;i<n;++i) pos[i]=ActionAtomistic::getPosition( getAtomIndex(current,i) );
+namespace {
+/// Positions of the atoms in a segment.  Each thread has its own copy
+/// so that no memory is allocated when the tasks are performed.
+std::vector<Vector>& getSegmentPositions( const unsigned& n ){
+  static thread_local std::vector<Vector> pos;
+  if( pos.size()!=n ) pos.resize( n );
+  return pos;
+}
+
+/// Centered positions of the atoms in a segment
+std::vector<Vector>& getCenteredPositions( const unsigned& n ){
+  static thread_local std::vector<Vector> pos;
+  if( pos.size()!=n ) pos.resize( n );
+  return pos;
+}
 
+/// Distances of a segment from all the reference structures
+std::vector<double>& getSegmentDistances(){
+  static thread_local std::vector<double> dist;
+  return dist;
+}
+}
+
+void SecondaryStructureRMSD::performTask( const unsigned& task_index, const unsigned& current, MultiValue& myvals ) const {
   // This does strands cutoff
-  Vector distance=pbcDistance( pos[align_atom_1],pos[align_atom_2] ); 
+  Vector distance=pbcDistance( ActionAtomistic::getPosition( getAtomIndex(current,align_atom_1) ),
+                               ActionAtomistic::getPosition( getAtomIndex(current,align_atom_2) ) ); 
   if( s_cutoff2>0 ){
      if( distance.modulo2()>s_cutoff2 ){
        myvals.setValue( 0, 0.0 );
@@ -200,6 +276,11 @@ void SecondaryStructureRMSD::performTask( const unsigned& task_index, const unsi
      }
   }
 
+  // Retrieve the positions
+  const unsigned n=references[0]->getNumberOfAtoms();
+  std::vector<Vector>& pos( getSegmentPositions( n ) );
+  for(unsigned i=0;i<n;++i) pos[i]=ActionAtomistic::getPosition( getAtomIndex(current,i) );
+
   // This aligns the two strands if this is required
   if( alignType!="DRMSD" && align_strands ){
      Vector origin_old, origin_new; origin_old=pos[align_atom_2];
@@ -214,18 +295,30 @@ void SecondaryStructureRMSD::performTask( const unsigned& task_index, const unsi
 
   // And now calculate the RMSD
   const Pbc& pbc=getPbc(); 
-  unsigned closest=0; 
-  double r = references[0]->calculate( pos, pbc, mypack, false );
+  unsigned closest=0; double r;
   const unsigned rs = references.size();
-  for(unsigned i=1;i<rs;++i){
-    mypack.setValIndex( i+1 );
-    double nr=references[i]->calculate( pos, pbc, mypack, false );
-    if( nr<r ){ closest=i; r=nr; }
+  if( rs>1 && rmsdbatch.getNumberOfReferences()==rs ){
+    // Find the closest reference first and only compute the derivatives for that one
+    std::vector<double>& dist( getSegmentDistances() );
+    rmsdbatch.calculate( pos, dist, false );
+    for(unsigned i=1;i<rs;++i) if( dist[i]<dist[closest] ) closest=i;
+    std::vector<Vector>& centered( getCenteredPositions( n ) );
+    rmsdbatch.center( pos, centered );
+    r=rmsdbatch.calculate( closest, centered, mypack.getAtomVector(), alignType=="OPTIMAL", false );
+    mypack.clear(); for(unsigned i=0;i<n;++i) mypack.setAtomDerivatives( i, mypack.getAtomVector()[i] );
+    if( !mypack.updateComplete() ) mypack.updateDynamicLists();
+  } else {
+    r = references[0]->calculate( pos, pbc, mypack, false );
+    for(unsigned i=1;i<rs;++i){
+      mypack.setValIndex( i+1 );
+      double nr=references[i]->calculate( pos, pbc, mypack, false );
+      if( nr<r ){ closest=i; r=nr; }
+    }
   }
 
   // Transfer everything to the value
   myvals.setValue( 0, 1.0 ); myvals.setValue( 1, r );
-  if( closest>0 ) mypack.moveDerivatives( closest+1, 1 );
+  if( closest>0 && rmsdbatch.getNumberOfReferences()!=rs ) mypack.moveDerivatives( closest+1, 1 );
 
   if( !mypack.virialWasSet() ){
     Tensor vir;
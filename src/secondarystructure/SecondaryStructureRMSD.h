@@ -25,6 +25,8 @@
 #include "core/ActionAtomistic.h"
 #include "core/ActionWithValue.h"
 #include "vesselbase/ActionWithVessel.h"
+#include "tools/LinkCells.h"
+#include "tools/RMSDBatch.h"
 #include <vector>
 
 namespace PLMD {
@@ -49,15 +51,33 @@ private:
   std::vector< std::vector<unsigned> > colvar_atoms;
 /// The list of reference configurations
   std::vector<SingleDomainRMSD*> references;
+/// The reference configurations packed together, used to compute all the optimal RMSDs at once
+  RMSDBatch rmsdbatch;
 /// Variables for strands cutoff
   bool align_strands;
   double s_cutoff2;
   unsigned align_atom_1, align_atom_2;
+/// The atoms that are used to compute the distance between the strands
+  std::vector<unsigned> strand_atoms;
+/// The tasks that have strand_atoms[i] as first alignment atom are
+/// strand_tasks[strand_starts[i]] ... strand_tasks[strand_starts[i+1]-1]. For each of
+/// them we store the index of the second alignment atom in strand_atoms and the task number.
+  std::vector<unsigned> strand_starts;
+  std::vector<std::pair<unsigned,unsigned> > strand_tasks;
+/// Link cells used to find the pairs of strands that are within the strands cutoff
+  LinkCells strand_cells;
+/// Tempory variables for the positions of the strand atoms
+  std::vector<Vector> strand_pos;
+  std::vector<unsigned> strand_ind, strand_linked;
   bool verbose_output;
 /// Tempory variables for getting positions of atoms and applying forces
   std::vector<double> forcesToApply;
 /// Get the index of an atom
   unsigned getAtomIndex( const unsigned& current, const unsigned& iatom ) const ;
+/// Setup the lists of tasks sorted by the atoms that are used for the strands cutoff
+  void setupStrandLists();
+/// Activate only the tasks for which the strands are closer than the strands cutoff
+  void activateCloseStrands();
 protected:
 /// Get the atoms in the backbone
   void readBackboneAtoms( const std::string& backnames, std::vector<unsigned>& chain_lengths );
@@ -142,6 +142,26 @@ void Communicator::Bcast(Data data,int root){
 #endif
 }
 
+// data should be passed by value to allow conversions
+// cppcheck-suppress passedByValue
+Communicator::Request Communicator::Ibcast(Data data,int root){
+  Request req;
+#if defined(__PLUMED_HAS_MPI)
+  plumed_massert(initialized(),"you are trying to use an MPI function, but MPI is not initialized");
+#if MPI_VERSION>=3
+  MPI_Ibcast(data.pointer,data.size,data.type,root,communicator,&req.r);
+#else
+  MPI_Bcast(data.pointer,data.size,data.type,root,communicator);
+  req.r=MPI_REQUEST_NULL;
+#endif
+#else
+  (void) data;
+  (void) root;
+  plumed_merror("you are trying to use an MPI function, but PLUMED has been compiled without MPI support");
+#endif
+  return req;
+}
+
 // data should be passed by value to allow conversions
 // cppcheck-suppress passedByValue
 void Communicator::Sum(Data data){
@@ -152,6 +172,25 @@ void Communicator::Sum(Data data){
 #endif
 }
 
+// data should be passed by value to allow conversions
+// cppcheck-suppress passedByValue
+Communicator::Request Communicator::Isum(Data data){
+  Request req;
+#if defined(__PLUMED_HAS_MPI)
+  plumed_massert(initialized(),"you are trying to use an MPI function, but MPI is not initialized");
+#if MPI_VERSION>=3
+  MPI_Iallreduce(MPI_IN_PLACE,data.pointer,data.size,data.type,MPI_SUM,communicator,&req.r);
+#else
+  MPI_Allreduce(MPI_IN_PLACE,data.pointer,data.size,data.type,MPI_SUM,communicator);
+  req.r=MPI_REQUEST_NULL;
+#endif
+#else
+  (void) data;
+  plumed_merror("you are trying to use an MPI function, but PLUMED has been compiled without MPI support");
+#endif
+  return req;
+}
+
 // data should be passed by value to allow conversions
 // cppcheck-suppress passedByValue
 Communicator::Request Communicator::Isend(ConstData data,int source,int tag){
@@ -205,6 +244,29 @@ void Communicator::Allgather(ConstData in,Data out){
 #endif
 }
 
+// data should be passed by value to allow conversions
+// cppcheck-suppress passedByValue
+Communicator::Request Communicator::Iallgather(ConstData in,Data out){
+  Request req;
+#if defined(__PLUMED_HAS_MPI)
+  plumed_massert(initialized(),"you are trying to use an MPI function, but MPI is not initialized");
+  void*s=const_cast<void*>((const void*)in.pointer);
+  void*r=const_cast<void*>((const void*)out.pointer);
+  if(s==NULL)s=MPI_IN_PLACE;
+#if MPI_VERSION>=3
+  MPI_Iallgather(s,in.size,in.type,r,out.size/Get_size(),out.type,communicator,&req.r);
+#else
+  MPI_Allgather(s,in.size,in.type,r,out.size/Get_size(),out.type,communicator);
+  req.r=MPI_REQUEST_NULL;
+#endif
+#else
+  (void) in;
+  (void) out;
+  plumed_merror("you are trying to use an MPI function, but PLUMED has been compiled without MPI support");
+#endif
+  return req;
+}
+
 // data should be passed by value to allow conversions
 // cppcheck-suppress passedByValue
 void Communicator::Recv(Data data,int source,int tag,Status&status){
@@ -182,12 +182,29 @@ public:
 /// Wrapper for MPI_Allreduce with MPI_SUM (reference)
   template <class T> void Sum(T&buf){Sum(Data(buf));}
 
+/// Wrapper for MPI_Iallreduce with MPI_SUM (data struct).
+/// When the MPI library does not provide nonblocking collectives (MPI<3)
+/// this falls back to a blocking MPI_Allreduce and returns a null request.
+  Request Isum(Data);
+/// Wrapper for MPI_Iallreduce with MPI_SUM (pointer)
+  template <class T> Request Isum(T*buf,int count){return Isum(Data(buf,count));}
+/// Wrapper for MPI_Iallreduce with MPI_SUM (reference)
+  template <class T> Request Isum(T&buf){return Isum(Data(buf));}
+
 /// Wrapper for MPI_Bcast (data struct)
   void Bcast(Data,int);
 /// Wrapper for MPI_Bcast (pointer)
   template <class T> void Bcast(T*buf,int count,int root){Bcast(Data(buf,count),root);}
 /// Wrapper for MPI_Bcast (reference)
   template <class T> void Bcast(T&buf,int root){Bcast(Data(buf),root);}
+/// Wrapper for MPI_Ibcast (data struct).
+/// When the MPI library does not provide nonblocking collectives (MPI<3)
+/// this falls back to a blocking MPI_Bcast and returns a null request.
+  Request Ibcast(Data,int);
+/// Wrapper for MPI_Ibcast (pointer)
+  template <class T> Request Ibcast(T*buf,int count,int root){return Ibcast(Data(buf,count),root);}
+/// Wrapper for MPI_Ibcast (reference)
+  template <class T> Request Ibcast(T&buf,int root){return Ibcast(Data(buf),root);}
 
 /// Wrapper for MPI_Isend (data struct)
   Request Isend(ConstData,int,int);
@@ -216,6 +233,19 @@ public:
     Allgather(ConstData(sendbuf),Data(recvbuf));
   }
 
+/// Wrapper for MPI_Iallgather (data struct).
+/// When the MPI library does not provide nonblocking collectives (MPI<3)
+/// this falls back to a blocking MPI_Allgather and returns a null request.
+  Request Iallgather(ConstData in,Data out);
+/// Wrapper for MPI_Iallgather (pointer)
+  template <class T,class S> Request Iallgather(const T*sendbuf,int sendcount,S*recvbuf,int recvcount){
+    return Iallgather(ConstData(sendbuf,sendcount),Data(recvbuf,recvcount*Get_size()));
+  }
+/// Wrapper for MPI_Iallgather (reference)
+  template <class T,class S> Request Iallgather(const T&sendbuf,S&recvbuf){
+    return Iallgather(ConstData(sendbuf),Data(recvbuf));
+  }
+
 /// Wrapper for MPI_Recv (data struct)
   void Recv(Data,int,int,Status&s=StatusIgnore);
 /// Wrapper for MPI_Recv (pointer)
@@ -0,0 +1,544 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2016 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#include "CompiledExpression.h"
+#include "Exception.h"
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <tuple>
+
+namespace PLMD{
+
+namespace {
+
+/// The operations. Constants and variables are nodes of the graph but they are not instructions
+enum Operation {
+  op_const, op_var,
+  op_add, op_sub, op_mul, op_div, op_pow,
+  op_neg, op_powi, op_powc,
+  op_exp, op_log, op_sqrt, op_sin, op_cos, op_tan, op_cot, op_sec, op_csc,
+  op_asin, op_acos, op_atan, op_acot, op_asec, op_acsc,
+  op_sinh, op_cosh, op_tanh, op_coth, op_sech, op_csch,
+  op_asinh, op_acosh, op_atanh, op_acoth, op_asech, op_acsch,
+  op_abs, op_step, op_delta, op_nandelta, op_erf
+};
+
+/// The names of the functions that are known to libmatheval, in the same order as the operations starting from op_exp
+const char* function_names[]={
+  "exp","log","sqrt","sin","cos","tan","cot","sec","csc",
+  "asin","acos","atan","acot","asec","acsc",
+  "sinh","cosh","tanh","coth","sech","csch",
+  "asinh","acosh","atanh","acoth","asech","acsch",
+  "abs","step","delta","nandelta","erf"
+};
+
+/// The constants that are known to libmatheval
+const char* constant_names[]={
+  "e","log2e","log10e","ln2","ln10","pi","pi_2","pi_4","1_pi","2_pi","2_sqrtpi","sqrt2","sqrt1_2"
+};
+const double constant_values[]={
+  M_E,M_LOG2E,M_LOG10E,M_LN2,M_LN10,M_PI,M_PI_2,M_PI_4,M_1_PI,M_2_PI,M_2_SQRTPI,M_SQRT2,M_SQRT1_2
+};
+
+/// Maximum number of points that are evaluated together
+const unsigned maxblock=64;
+
+/// Scratch space for the registers
+std::vector<double>& registerStorage(){
+  static thread_local std::vector<double> storage;
+  return storage;
+}
+
+inline bool isLeaf( const unsigned& op ){
+  return op==op_const || op==op_var;
+}
+
+inline bool isBinary( const unsigned& op ){
+  return op>=op_add && op<=op_pow;
+}
+
+inline double intPow( double x, const int& e ){
+  unsigned n = e<0 ? -e : e; double r=1.0;
+  while(n){
+    if(n&1) r*=x;
+    x*=x; n>>=1;
+  }
+  return e<0 ? 1.0/r : r;
+}
+
+/// Apply an operation to n points. r can be the same array as x or y
+void apply( const unsigned& op, const unsigned& n, const double* x, const double* y, const double& c, double* r ){
+  switch(op){
+    case op_add: for(unsigned i=0;i<n;++i) r[i]=x[i]+y[i]; break;
+    case op_sub: for(unsigned i=0;i<n;++i) r[i]=x[i]-y[i]; break;
+    case op_mul: for(unsigned i=0;i<n;++i) r[i]=x[i]*y[i]; break;
+    case op_div: for(unsigned i=0;i<n;++i) r[i]=x[i]/y[i]; break;
+    case op_pow: for(unsigned i=0;i<n;++i) r[i]=std::pow(x[i],y[i]); break;
+    case op_neg: for(unsigned i=0;i<n;++i) r[i]=-x[i]; break;
+    case op_powi: { const int e=static_cast<int>(c); for(unsigned i=0;i<n;++i) r[i]=intPow(x[i],e); } break;
+    case op_powc: for(unsigned i=0;i<n;++i) r[i]=std::pow(x[i],c); break;
+    case op_exp: for(unsigned i=0;i<n;++i) r[i]=std::exp(x[i]); break;
+    case op_log: for(unsigned i=0;i<n;++i) r[i]=std::log(x[i]); break;
+    case op_sqrt: for(unsigned i=0;i<n;++i) r[i]=std::sqrt(x[i]); break;
+    case op_sin: for(unsigned i=0;i<n;++i) r[i]=std::sin(x[i]); break;
+    case op_cos: for(unsigned i=0;i<n;++i) r[i]=std::cos(x[i]); break;
+    case op_tan: for(unsigned i=0;i<n;++i) r[i]=std::tan(x[i]); break;
+    case op_cot: for(unsigned i=0;i<n;++i) r[i]=1.0/std::tan(x[i]); break;
+    case op_sec: for(unsigned i=0;i<n;++i) r[i]=1.0/std::cos(x[i]); break;
+    case op_csc: for(unsigned i=0;i<n;++i) r[i]=1.0/std::sin(x[i]); break;
+    case op_asin: for(unsigned i=0;i<n;++i) r[i]=std::asin(x[i]); break;
+    case op_acos: for(unsigned i=0;i<n;++i) r[i]=std::acos(x[i]); break;
+    case op_atan: for(unsigned i=0;i<n;++i) r[i]=std::atan(x[i]); break;
+    case op_acot: for(unsigned i=0;i<n;++i) r[i]=std::atan(1.0/x[i]); break;
+    case op_asec: for(unsigned i=0;i<n;++i) r[i]=std::acos(1.0/x[i]); break;
+    case op_acsc: for(unsigned i=0;i<n;++i) r[i]=std::asin(1.0/x[i]); break;
+    case op_sinh: for(unsigned i=0;i<n;++i) r[i]=std::sinh(x[i]); break;
+    case op_cosh: for(unsigned i=0;i<n;++i) r[i]=std::cosh(x[i]); break;
+    case op_tanh: for(unsigned i=0;i<n;++i) r[i]=std::tanh(x[i]); break;
+    case op_coth: for(unsigned i=0;i<n;++i) r[i]=1.0/std::tanh(x[i]); break;
+    case op_sech: for(unsigned i=0;i<n;++i) r[i]=1.0/std::cosh(x[i]); break;
+    case op_csch: for(unsigned i=0;i<n;++i) r[i]=1.0/std::sinh(x[i]); break;
+    case op_asinh: for(unsigned i=0;i<n;++i) r[i]=std::asinh(x[i]); break;
+    case op_acosh: for(unsigned i=0;i<n;++i) r[i]=std::acosh(x[i]); break;
+    case op_atanh: for(unsigned i=0;i<n;++i) r[i]=std::atanh(x[i]); break;
+    case op_acoth: for(unsigned i=0;i<n;++i) r[i]=std::atanh(1.0/x[i]); break;
+    case op_asech: for(unsigned i=0;i<n;++i) r[i]=std::acosh(1.0/x[i]); break;
+    case op_acsch: for(unsigned i=0;i<n;++i) r[i]=std::asinh(1.0/x[i]); break;
+    case op_abs: for(unsigned i=0;i<n;++i) r[i]=std::fabs(x[i]); break;
+    case op_step: for(unsigned i=0;i<n;++i) r[i]=( x[i]<0 ? 0.0 : 1.0 ); break;
+    case op_delta: for(unsigned i=0;i<n;++i) r[i]=( x[i]==0 ? std::numeric_limits<double>::infinity() : 0.0 ); break;
+    case op_nandelta: for(unsigned i=0;i<n;++i) r[i]=( x[i]==0 ? std::numeric_limits<double>::quiet_NaN() : 0.0 ); break;
+    case op_erf: for(unsigned i=0;i<n;++i) r[i]=std::erf(x[i]); break;
+    default: plumed_merror("unknown operation in compiled expression");
+  }
+}
+
+/// A node of the graph. For variables c is the index of the variable
+struct Node {
+  unsigned op;
+  int a, b;
+  double c;
+};
+
+/// The graph of the expression and of its derivatives.
+/// Nodes are only added once, so identical subexpressions share the same node,
+/// and the operands of a node always come before the node itself
+class Graph {
+private:
+/// Constants are keyed by their bit pattern, since NaN cannot be compared
+  std::map<std::tuple<unsigned,int,int,std::uint64_t>,int> index;
+  int add( const unsigned& op, const int& a, const int& b, const double& c );
+  bool isConstant( const int& n, const double& v ) const ;
+/// Check if a node is a constant that is finite and not zero
+  bool isFiniteNonZero( const int& n ) const ;
+/// The derivative of a function with respect to its argument x (self is the node of the function)
+  int functionDerivative( const unsigned& op, const int& x, const int& self, const double& c );
+public:
+  std::vector<Node> nodes;
+  int constant( const double& c );
+  int variable( const unsigned& k );
+/// Create a node, simplifying it and evaluating it if all its operands are constants
+  int make( const unsigned& op, const int& a, const int& b=-1, const double& c=0.0 );
+/// Get the derivative of a node with respect to variable k. memo stores the derivatives that were already computed
+  int derivative( const int& n, const unsigned& k, std::map<int,int>& memo );
+};
+
+int Graph::add( const unsigned& op, const int& a, const int& b, const double& c ){
+  std::uint64_t bits;
+  std::memcpy( &bits, &c, sizeof(bits) );
+  std::tuple<unsigned,int,int,std::uint64_t> key( op, a, b, bits );
+  std::map<std::tuple<unsigned,int,int,std::uint64_t>,int>::const_iterator it=index.find( key );
+  if( it!=index.end() ) return it->second;
+  Node nn; nn.op=op; nn.a=a; nn.b=b; nn.c=c;
+  nodes.push_back( nn ); index[key]=nodes.size()-1;
+  return nodes.size()-1;
+}
+
+bool Graph::isConstant( const int& n, const double& v ) const {
+  return nodes[n].op==op_const && nodes[n].c==v;
+}
+
+bool Graph::isFiniteNonZero( const int& n ) const {
+  return nodes[n].op==op_const && std::isfinite(nodes[n].c) && nodes[n].c!=0;
+}
+
+int Graph::constant( const double& c ){
+  // Make sure that 0 and -0 are the same node
+  return add( op_const, -1, -1, (c==0 ? 0.0 : c) );
+}
+
+int Graph::variable( const unsigned& k ){
+  return add( op_var, -1, -1, k );
+}
+
+int Graph::make( const unsigned& op, const int& a0, const int& b0, const double& c ){
+  int a=a0, b=b0;
+  // Sort the operands of commutative operations so that x*y and y*x are the same node
+  if( (op==op_add || op==op_mul) && b<a ){ a=b0; b=a0; }
+  const bool ca=(nodes[a].op==op_const), cb=(b>=0 && nodes[b].op==op_const);
+  if( ca && (b<0 || cb) ){
+    double va=nodes[a].c, vb=( b>=0 ? nodes[b].c : 0.0 ), r;
+    apply( op, 1, &va, &vb, c, &r );
+    // Non finite results are left to be computed at run time, as libmatheval would do
+    if( std::isfinite(r) ) return constant( r );
+  }
+  switch(op){
+    case op_add:
+      if( isConstant(a,0) ) return b;
+      if( isConstant(b,0) ) return a;
+      break;
+    case op_sub:
+      if( isConstant(b,0) ) return a;
+      if( isConstant(a,0) ) return make( op_neg, b );
+      break;
+    case op_mul:
+      // 0*x is only zero when x is finite
+      if( (isConstant(a,0) && isFiniteNonZero(b)) || (isConstant(b,0) && isFiniteNonZero(a)) ) return constant(0);
+      if( isConstant(a,1) ) return b;
+      if( isConstant(b,1) ) return a;
+      if( isConstant(a,-1) ) return make( op_neg, b );
+      if( isConstant(b,-1) ) return make( op_neg, a );
+      if( a==b ) return make( op_powi, a, -1, 2 );
+      break;
+    case op_div:
+      if( isConstant(a,0) && isFiniteNonZero(b) ) return constant(0);
+      if( isConstant(b,1) ) return a;
+      break;
+    case op_neg:
+      if( nodes[a].op==op_neg ) return nodes[a].a;
+      break;
+    case op_pow:
+      if( cb ) return make( op_powc, a, -1, nodes[b].c );
+      break;
+    case op_powc:
+      if( c==0 ) return constant(1);
+      if( c==1 ) return a;
+      if( c==std::floor(c) && std::fabs(c)<=64 ) return add( op_powi, a, -1, c );
+      break;
+    case op_powi:
+      if( c==0 ) return constant(1);
+      if( c==1 ) return a;
+      break;
+  }
+  return add( op, a, (isBinary(op) ? b : -1), c );
+}
+
+int Graph::functionDerivative( const unsigned& op, const int& x, const int& self, const double& c ){
+  const int one=constant(1);
+  switch(op){
+    case op_powi:
+    case op_powc: return make( op_mul, constant(c), make( op_powc, x, -1, c-1 ) );
+    case op_exp: return self;
+    case op_log: return make( op_div, one, x );
+    case op_sqrt: return make( op_div, constant(0.5), self );
+    case op_sin: return make( op_cos, x );
+    case op_cos: return make( op_neg, make( op_sin, x ) );
+    case op_tan: return make( op_add, one, make( op_powi, self, -1, 2 ) );
+    case op_cot: return make( op_neg, make( op_add, one, make( op_powi, self, -1, 2 ) ) );
+    case op_sec: return make( op_mul, self, make( op_tan, x ) );
+    case op_csc: return make( op_neg, make( op_mul, self, make( op_cot, x ) ) );
+    case op_asin: return make( op_div, one, make( op_sqrt, make( op_sub, one, make( op_powi, x, -1, 2 ) ) ) );
+    case op_acos: return make( op_neg, make( op_div, one, make( op_sqrt, make( op_sub, one, make( op_powi, x, -1, 2 ) ) ) ) );
+    case op_atan: return make( op_div, one, make( op_add, one, make( op_powi, x, -1, 2 ) ) );
+    case op_acot: return make( op_neg, make( op_div, one, make( op_add, one, make( op_powi, x, -1, 2 ) ) ) );
+    case op_asec: return make( op_div, one, make( op_mul, make( op_powi, x, -1, 2 ), make( op_sqrt, make( op_sub, one, make( op_powi, x, -1, -2 ) ) ) ) );
+    case op_acsc: return make( op_neg, make( op_div, one, make( op_mul, make( op_powi, x, -1, 2 ), make( op_sqrt, make( op_sub, one, make( op_powi, x, -1, -2 ) ) ) ) ) );
+    case op_sinh: return make( op_cosh, x );
+    case op_cosh: return make( op_sinh, x );
+    case op_tanh:
+    case op_coth: return make( op_sub, one, make( op_powi, self, -1, 2 ) );
+    case op_sech: return make( op_neg, make( op_mul, self, make( op_tanh, x ) ) );
+    case op_csch: return make( op_neg, make( op_mul, self, make( op_coth, x ) ) );
+    case op_asinh: return make( op_div, one, make( op_sqrt, make( op_add, make( op_powi, x, -1, 2 ), one ) ) );
+    case op_acosh: return make( op_div, one, make( op_sqrt, make( op_sub, make( op_powi, x, -1, 2 ), one ) ) );
+    case op_atanh:
+    case op_acoth: return make( op_div, one, make( op_sub, one, make( op_powi, x, -1, 2 ) ) );
+    case op_asech: return make( op_neg, make( op_div, one, make( op_mul, x, make( op_sqrt, make( op_sub, one, make( op_powi, x, -1, 2 ) ) ) ) ) );
+    case op_acsch: return make( op_neg, make( op_div, one, make( op_mul, make( op_powi, x, -1, 2 ), make( op_sqrt, make( op_add, one, make( op_powi, x, -1, -2 ) ) ) ) ) );
+    case op_abs: return make( op_sub, make( op_step, x ), make( op_step, make( op_neg, x ) ) );
+    case op_step: return make( op_delta, x );
+    case op_delta:
+    case op_nandelta: return make( op_nandelta, x );
+    case op_erf: return make( op_mul, constant(M_2_SQRTPI), make( op_exp, make( op_neg, make( op_powi, x, -1, 2 ) ) ) );
+  }
+  plumed_merror("unknown operation in compiled expression");
+  return -1;
+}
+
+int Graph::derivative( const int& n, const unsigned& k, std::map<int,int>& memo ){
+  std::map<int,int>::const_iterator it=memo.find(n);
+  if( it!=memo.end() ) return it->second;
+  // Nodes are copied because new nodes are added below
+  const Node nd=nodes[n]; int r;
+  if( nd.op==op_const ){
+    r=constant(0);
+  } else if( nd.op==op_var ){
+    r=constant( static_cast<unsigned>(nd.c)==k ? 1 : 0 );
+  } else {
+    const int x=nd.a, y=nd.b, dx=derivative( x, k, memo ), dy=( isBinary(nd.op) ? derivative( y, k, memo ) : -1 );
+    // Operands that do not depend on variable k give no terms in the derivative
+    // (0*x is not simplified by make, since x could be infinite)
+    const bool zx=isConstant(dx,0), zy=( dy<0 || isConstant(dy,0) );
+    if( zx && zy ){
+      r=constant(0);
+    } else switch(nd.op){
+      case op_add: r=make( op_add, dx, dy ); break;
+      case op_sub: r=make( op_sub, dx, dy ); break;
+      case op_mul:
+        if( zy ) r=make( op_mul, dx, y );
+        else if( zx ) r=make( op_mul, x, dy );
+        else r=make( op_add, make( op_mul, dx, y ), make( op_mul, x, dy ) );
+        break;
+      case op_div:
+        if( zy ) r=make( op_div, make( op_mul, dx, y ), make( op_powi, y, -1, 2 ) );
+        else if( zx ) r=make( op_div, make( op_neg, make( op_mul, x, dy ) ), make( op_powi, y, -1, 2 ) );
+        else r=make( op_div, make( op_sub, make( op_mul, dx, y ), make( op_mul, x, dy ) ), make( op_powi, y, -1, 2 ) );
+        break;
+      case op_pow:
+        if( zy ){
+          r=make( op_mul, make( op_mul, y, make( op_pow, x, make( op_sub, y, constant(1) ) ) ), dx );
+        } else if( zx ){
+          r=make( op_mul, n, make( op_mul, dy, make( op_log, x ) ) );
+        } else {
+          r=make( op_mul, n, make( op_add, make( op_mul, dy, make( op_log, x ) ), make( op_div, make( op_mul, y, dx ), x ) ) );
+        }
+        break;
+      case op_neg: r=make( op_neg, dx ); break;
+      default: r=make( op_mul, functionDerivative( nd.op, x, n, nd.c ), dx );
+    }
+  }
+  memo[n]=r;
+  return r;
+}
+
+/// A recursive descent parser for the syntax used by libmatheval
+class Parser {
+private:
+  const std::string& s;
+  const std::vector<std::string>& vars;
+  Graph& g;
+  unsigned pos;
+  void error( const std::string& msg ) const ;
+  void skip();
+  bool accept( const char& c );
+  int expr();
+  int term();
+  int unary();
+  int power();
+  int primary();
+public:
+  Parser( const std::string& str, const std::vector<std::string>& v, Graph& graph );
+  int parse();
+};
+
+Parser::Parser( const std::string& str, const std::vector<std::string>& v, Graph& graph ):
+  s(str),
+  vars(v),
+  g(graph),
+  pos(0)
+{
+}
+
+void Parser::error( const std::string& msg ) const {
+  plumed_merror("error parsing expression " + s + " : " + msg);
+}
+
+void Parser::skip(){
+  while( pos<s.length() && std::isspace(s[pos]) ) pos++;
+}
+
+bool Parser::accept( const char& c ){
+  skip();
+  if( pos<s.length() && s[pos]==c ){ pos++; return true; }
+  return false;
+}
+
+int Parser::parse(){
+  int r=expr(); skip();
+  if( pos!=s.length() ) error("unexpected character " + s.substr(pos,1));
+  return r;
+}
+
+int Parser::expr(){
+  int r=term();
+  while(true){
+    if( accept('+') ) r=g.make( op_add, r, term() );
+    else if( accept('-') ) r=g.make( op_sub, r, term() );
+    else return r;
+  }
+}
+
+int Parser::term(){
+  int r=unary();
+  while(true){
+    if( accept('*') ) r=g.make( op_mul, r, unary() );
+    else if( accept('/') ) r=g.make( op_div, r, unary() );
+    else return r;
+  }
+}
+
+int Parser::unary(){
+  if( accept('-') ) return g.make( op_neg, unary() );
+  return power();
+}
+
+int Parser::power(){
+  int r=primary();
+  // The exponent is parsed with unary() so that ^ is right associative and x^-y works
+  if( accept('^') ) r=g.make( op_pow, r, unary() );
+  return r;
+}
+
+int Parser::primary(){
+  skip();
+  if( pos==s.length() ) error("unexpected end of expression");
+  if( accept('(') ){
+    int r=expr();
+    if( !accept(')') ) error("missing )");
+    return r;
+  }
+  // Identifiers (constants such as 1_pi also start with a digit)
+  unsigned end=pos;
+  while( end<s.length() && (std::isalnum(s[end]) || s[end]=='_') ) end++;
+  std::string name=s.substr(pos,end-pos);
+  for(unsigned i=0;i<sizeof(constant_names)/sizeof(constant_names[0]);++i){
+    if( name==constant_names[i] ){ pos=end; return g.constant( constant_values[i] ); }
+  }
+  if( std::isdigit(s[pos]) || s[pos]=='.' ){
+    const char* start=s.c_str()+pos; char* stop;
+    double val=std::strtod( start, &stop );
+    if( stop==start ) error("cannot read number");
+    pos+=stop-start;
+    return g.constant( val );
+  }
+  if( name.empty() ) error("unexpected character " + s.substr(pos,1));
+  pos=end;
+  if( accept('(') ){
+    for(unsigned i=0;i<sizeof(function_names)/sizeof(function_names[0]);++i){
+      if( name==function_names[i] ){
+        int arg=expr();
+        if( !accept(')') ) error("missing ) after argument of " + name);
+        return g.make( op_exp+i, arg );
+      }
+    }
+    error("unknown function " + name);
+  }
+  for(unsigned i=0;i<vars.size();++i){
+    if( name==vars[i] ) return g.variable( i );
+  }
+  error("unknown variable " + name);
+  return -1;
+}
+
+}
+
+CompiledExpression::CompiledExpression():
+  nregisters(0)
+{
+}
+
+void CompiledExpression::set( const std::string& expr, const std::vector<std::string>& vars, const bool& derivatives ){
+  expression=expr; variables=vars;
+  code.clear(); constants.clear(); constant_registers.clear();
+  variable_registers.clear(); output_registers.clear(); nregisters=0;
+
+  // Build the graph of the expression and of its derivatives
+  Graph g; Parser p( expression, variables, g );
+  std::vector<int> outputs( 1, p.parse() );
+  if( derivatives ){
+    for(unsigned k=0;k<variables.size();++k){
+      std::map<int,int> memo; outputs.push_back( g.derivative( outputs[0], k, memo ) );
+    }
+  }
+
+  // Find the nodes that are needed and where each of them is used for the last time
+  const unsigned nnodes=g.nodes.size();
+  std::vector<bool> needed( nnodes, false );
+  for(unsigned i=0;i<outputs.size();++i) needed[outputs[i]]=true;
+  std::vector<unsigned> lastuse( nnodes, 0 );
+  for(int i=nnodes-1;i>=0;--i){
+    if( !needed[i] || isLeaf(g.nodes[i].op) ) continue;
+    needed[g.nodes[i].a]=true; if( lastuse[g.nodes[i].a]<unsigned(i) ) lastuse[g.nodes[i].a]=i;
+    if( g.nodes[i].b>=0 ){ needed[g.nodes[i].b]=true; if( lastuse[g.nodes[i].b]<unsigned(i) ) lastuse[g.nodes[i].b]=i; }
+  }
+  for(unsigned i=0;i<outputs.size();++i) lastuse[outputs[i]]=nnodes;
+
+  // Constants and variables have their own registers
+  std::vector<unsigned> reg( nnodes, 0 );
+  for(unsigned k=0;k<variables.size();++k) variable_registers.push_back( nregisters++ );
+  for(unsigned i=0;i<nnodes;++i){
+    if( !needed[i] ) continue;
+    if( g.nodes[i].op==op_const ){
+      reg[i]=nregisters++; constant_registers.push_back( reg[i] ); constants.push_back( g.nodes[i].c );
+    } else if( g.nodes[i].op==op_var ){
+      reg[i]=variable_registers[ static_cast<unsigned>(g.nodes[i].c) ];
+    }
+  }
+  // The registers of the other nodes are reused as soon as their value is not needed anymore
+  std::vector<unsigned> freeregs;
+  for(unsigned i=0;i<nnodes;++i){
+    const Node& nd=g.nodes[i];
+    if( !needed[i] || isLeaf(nd.op) ) continue;
+    if( !isLeaf(g.nodes[nd.a].op) && lastuse[nd.a]==i ) freeregs.push_back( reg[nd.a] );
+    if( nd.b>=0 && nd.b!=nd.a && !isLeaf(g.nodes[nd.b].op) && lastuse[nd.b]==i ) freeregs.push_back( reg[nd.b] );
+    if( freeregs.empty() ) reg[i]=nregisters++;
+    else { reg[i]=freeregs.back(); freeregs.pop_back(); }
+    Instruction ins; ins.op=nd.op; ins.dest=reg[i]; ins.a=reg[nd.a];
+    ins.b=( nd.b>=0 ? reg[nd.b] : reg[nd.a] ); ins.c=nd.c;
+    code.push_back( ins );
+  }
+  for(unsigned i=0;i<outputs.size();++i) output_registers.push_back( reg[outputs[i]] );
+}
+
+void CompiledExpression::evaluate( const unsigned& n, const double* vars, double* outputs ) const {
+  if( n==0 ) return;
+  const unsigned nvars=variables.size(), nout=output_registers.size();
+  const unsigned block=( n<maxblock ? n : maxblock );
+  std::vector<double>& storage( registerStorage() );
+  if( storage.size()<nregisters*block ) storage.resize( nregisters*block );
+  double* r=storage.data();
+  for(unsigned k=0;k<constants.size();++k){
+    double* rc=r+constant_registers[k]*block;
+    for(unsigned i=0;i<block;++i) rc[i]=constants[k];
+  }
+  for(unsigned start=0;start<n;start+=block){
+    const unsigned m=( n-start<block ? n-start : block );
+    for(unsigned k=0;k<nvars;++k){
+      double* rv=r+variable_registers[k]*block;
+      for(unsigned i=0;i<m;++i) rv[i]=vars[(start+i)*nvars+k];
+    }
+    for(unsigned j=0;j<code.size();++j){
+      const Instruction& ins=code[j];
+      apply( ins.op, m, r+ins.a*block, r+ins.b*block, ins.c, r+ins.dest*block );
+    }
+    for(unsigned k=0;k<nout;++k){
+      const double* ro=r+output_registers[k]*block;
+      for(unsigned i=0;i<m;++i) outputs[(start+i)*nout+k]=ro[i];
+    }
+  }
+}
+
+}
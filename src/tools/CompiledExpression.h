@@ -0,0 +1,124 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2016 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#ifndef __PLUMED_tools_CompiledExpression_h
+#define __PLUMED_tools_CompiledExpression_h
+
+#include <string>
+#include <vector>
+
+namespace PLMD{
+
+/**
+\ingroup TOOLBOX
+A class for evaluating a mathematical expression and its derivatives many times.
+
+The expression is parsed once, using the same syntax as libmatheval, and it is differentiated
+symbolically. The expression and its derivatives are stored in a single graph in which
+identical subexpressions appear only once, so that they are also computed only once.
+The graph is then compiled into a flat list of instructions acting on a set of registers.
+When many points are evaluated together each instruction is applied to a block of points
+before moving to the next one, so that the cost of decoding the instructions is shared.
+
+\verbatim
+std::vector<std::string> var(2); var[0]="x"; var[1]="y";
+CompiledExpression ce;
+ce.set( "exp(-x^2)*y", var, true );
+// Three outputs: the value and the derivatives with respect to x and y
+double in[2]={1.0,2.0}, out[3];
+ce.evaluate( in, out );
+\endverbatim
+*/
+class CompiledExpression {
+public:
+/// A single instruction
+  struct Instruction {
+/// The operation
+    unsigned op;
+/// The destination and the operand registers
+    unsigned dest, a, b;
+/// A constant used by some of the operations (e.g. the exponent in integer powers)
+    double c;
+  };
+private:
+/// The expression that was compiled
+  std::string expression;
+/// The names of the variables
+  std::vector<std::string> variables;
+/// The list of instructions
+  std::vector<Instruction> code;
+/// The constants and the registers in which they are stored
+  std::vector<double> constants;
+  std::vector<unsigned> constant_registers;
+/// The registers in which variables are loaded
+  std::vector<unsigned> variable_registers;
+/// The register containing each of the outputs
+  std::vector<unsigned> output_registers;
+/// The number of registers
+  unsigned nregisters;
+public:
+  CompiledExpression();
+/// Compile an expression. If derivatives is true the outputs are the value of the expression
+/// followed by its derivatives with respect to each of the variables, otherwise only the value
+  void set( const std::string& expression, const std::vector<std::string>& variables, const bool& derivatives );
+/// Return the expression
+  const std::string& getExpression() const ;
+/// Get the number of variables
+  unsigned getNumberOfVariables() const ;
+/// Get the number of outputs
+  unsigned getNumberOfOutputs() const ;
+/// Get the number of instructions
+  unsigned getNumberOfInstructions() const ;
+/// Evaluate the outputs at a single point
+  void evaluate( const double* vars, double* outputs ) const ;
+/// Evaluate the outputs at n points. Variable j of point i is in vars[i*getNumberOfVariables()+j]
+/// and output k of point i is stored in outputs[i*getNumberOfOutputs()+k]
+  void evaluate( const unsigned& n, const double* vars, double* outputs ) const ;
+};
+
+inline
+const std::string& CompiledExpression::getExpression() const {
+  return expression;
+}
+
+inline
+unsigned CompiledExpression::getNumberOfVariables() const {
+  return variables.size();
+}
+
+inline
+unsigned CompiledExpression::getNumberOfOutputs() const {
+  return output_registers.size();
+}
+
+inline
+unsigned CompiledExpression::getNumberOfInstructions() const {
+  return code.size();
+}
+
+inline
+void CompiledExpression::evaluate( const double* vars, double* outputs ) const {
+  evaluate( 1, vars, outputs );
+}
+
+}
+
+#endif
@@ -35,6 +35,17 @@
 #include <sstream>
 #include <cstdio>
 #include <cfloat>
+#include <atomic>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#if defined(_POSIX_SHARED_MEMORY_OBJECTS) && _POSIX_SHARED_MEMORY_OBJECTS>0
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <signal.h>
+#define __PLUMED_GRID_HAS_SHM 1
+#endif
 
 using namespace std;
 namespace PLMD{
@@ -668,6 +679,161 @@ Grid* Grid::create(const std::string& funcl, const std::vector<Value*> & args, I
  return grid;
 }
 
+// Binary grid files start with this signature, followed by a check value
+// used to detect files written on machines with a different endianness
+static const char gridBinaryMagic[8]={'P','L','M','D','G','R','I','D'};
+static const unsigned gridBinaryCheck=0x01020304;
+
+static void writeBinaryString(FILE* fp,const std::string& str){
+ unsigned len=str.length();
+ plumed_assert(fwrite(&len,sizeof(len),1,fp)==1);
+ if(len>0) plumed_assert(fwrite(str.c_str(),1,len,fp)==len);
+}
+
+static std::string readBinaryString(FILE* fp){
+ unsigned len;
+ plumed_massert(fread(&len,sizeof(len),1,fp)==1,"error reading binary grid file");
+ std::string str(len,' ');
+ if(len>0) plumed_massert(fread(&str[0],1,len,fp)==len,"error reading binary grid file");
+ return str;
+}
+
+bool Grid::isBinaryFile(const std::string& filename){
+ FILE* fp=std::fopen(filename.c_str(),"rb");
+ if(!fp) return false;
+ char magic[sizeof(gridBinaryMagic)];
+ bool found=(fread(magic,1,sizeof(magic),fp)==sizeof(magic) && std::memcmp(magic,gridBinaryMagic,sizeof(magic))==0);
+ std::fclose(fp);
+ return found;
+}
+
+void Grid::writeBinary(const std::string& filename) const {
+ FILE* fp=std::fopen(filename.c_str(),"wb");
+ if(!fp) plumed_merror("cannot open binary grid file " + filename + " for writing");
+ plumed_assert(fwrite(gridBinaryMagic,1,sizeof(gridBinaryMagic),fp)==sizeof(gridBinaryMagic));
+ unsigned header[3]; header[0]=gridBinaryCheck; header[1]=dimension_; header[2]=usederiv_;
+ plumed_assert(fwrite(header,sizeof(unsigned),3,fp)==3);
+ writeBinaryString(fp,funcname);
+ for(unsigned i=0;i<dimension_;++i){
+   writeBinaryString(fp,argnames[i]);
+   writeBinaryString(fp,str_min_[i]);
+   writeBinaryString(fp,str_max_[i]);
+   unsigned info[2]; info[0]=nbin_[i]; info[1]=pbc_[i];
+   plumed_assert(fwrite(info,sizeof(unsigned),2,fp)==2);
+ }
+ unsigned long long npoints=maxsize_;
+ plumed_assert(fwrite(&npoints,sizeof(npoints),1,fp)==1);
+// values and derivatives are written point by point, in chunks to limit the number of calls to fwrite
+ const unsigned stride=(usederiv_?1+dimension_:1);
+ const index_t chunk=4096;
+ vector<double> buffer(chunk*stride);
+ vector<double> der(dimension_);
+ for(index_t i=0;i<maxsize_;i+=chunk){
+   index_t n=std::min(chunk,maxsize_-i);
+   for(index_t j=0;j<n;++j){
+     if(usederiv_){
+       buffer[j*stride]=getValueAndDerivatives(i+j,der);
+       for(unsigned k=0;k<dimension_;++k) buffer[j*stride+1+k]=der[k];
+     } else buffer[j*stride]=getValue(i+j);
+   }
+   if(fwrite(&buffer[0],sizeof(double),n*stride,fp)!=n*stride) plumed_merror("error writing binary grid file " + filename);
+ }
+ if(std::fclose(fp)!=0) plumed_merror("error closing binary grid file " + filename);
+}
+
+Grid* Grid::createFromBinary(const std::string& funcl, const std::vector<Value*> & args, const std::string& filename,
+                             const vector<std::string> & gmin,const vector<std::string> & gmax,
+                             const vector<unsigned> & nbin,bool dosparse, bool dospline, bool doder){
+  Grid* grid=Grid::createFromBinary(funcl,args,filename,dosparse,dospline,doder);
+  std::vector<unsigned> cbin( grid->getNbin() );
+  std::vector<std::string> cmin( grid->getMin() ), cmax( grid->getMax() );
+  for(unsigned i=0;i<args.size();++i){
+      plumed_massert( cmin[i]==gmin[i], "mismatched grid min" );
+      plumed_massert( cmax[i]==gmax[i], "mismatched grid max" );
+      if( args[i]->isPeriodic() ){
+        plumed_massert( cbin[i]==nbin[i], "mismatched grid nbins" );
+      } else {
+        plumed_massert( (cbin[i]-1)==nbin[i], "mismatched grid nbins");
+      }
+  }
+  return grid;
+}
+
+Grid* Grid::createFromBinary(const std::string& funcl, const std::vector<Value*> & args, const std::string& filename, bool dosparse, bool dospline, bool doder)
+{
+ FILE* fp=std::fopen(filename.c_str(),"rb");
+ if(!fp) plumed_merror("cannot open binary grid file " + filename);
+ char magic[sizeof(gridBinaryMagic)];
+ if(fread(magic,1,sizeof(magic),fp)!=sizeof(magic) || std::memcmp(magic,gridBinaryMagic,sizeof(magic))!=0) plumed_merror(filename + " is not a binary grid file");
+ unsigned header[3];
+ if(fread(header,sizeof(unsigned),3,fp)!=3) plumed_merror("error reading binary grid file " + filename);
+ if(header[0]!=gridBinaryCheck) plumed_merror("binary grid file " + filename + " has been written on a machine with different endianness");
+ unsigned nvar=args.size();
+ if(header[1]!=nvar) plumed_merror("mismatch between dimensionality of binary grid file " + filename + " and number of arguments");
+ bool hasder=header[2];
+ if( doder && !hasder ) plumed_merror("missing derivatives from grid file");
+ plumed_massert( readBinaryString(fp)==funcl, "no function labelled " + funcl + " in grid input");
+ std::vector<unsigned> gbin(nvar);
+ std::vector<std::string> gmin(nvar),gmax(nvar);
+ for(unsigned i=0;i<nvar;++i){
+     if( readBinaryString(fp)!=args[i]->getName() ) plumed_merror("arguments in input are not in same order as in grid file");
+     gmin[i]=readBinaryString(fp);
+     gmax[i]=readBinaryString(fp);
+     unsigned info[2];
+     if(fread(info,sizeof(unsigned),2,fp)!=2) plumed_merror("error reading binary grid file " + filename);
+     plumed_assert( info[0]>0 );
+     if( args[i]->isPeriodic() ){
+         plumed_massert( info[1], "input value is periodic but grid is not");
+         std::string pmin, pmax;
+         args[i]->getDomain( pmin, pmax ); gbin[i]=info[0];
+         if( pmin!=gmin[i] || pmax!=gmax[i] ) plumed_merror("mismatch between grid boundaries and periods of values");
+     } else {
+         gbin[i]=info[0]-1;  // as in text files, the stored number of bins includes the extra point of non periodic grids
+         plumed_massert( !info[1], "input value is not periodic but grid is");
+     }
+ }
+
+ Grid* grid=NULL;
+ if(!dosparse){grid=new Grid(funcl,args,gmin,gmax,gbin,dospline,doder);}
+ else{grid=new SparseGrid(funcl,args,gmin,gmax,gbin,dospline,doder);}
+
+ unsigned long long npoints;
+ if(fread(&npoints,sizeof(npoints),1,fp)!=1) plumed_merror("error reading binary grid file " + filename);
+ if(npoints!=grid->maxsize_) plumed_merror("number of points in binary grid file " + filename + " is not consistent with its header");
+ const unsigned stride=(hasder?1+nvar:1);
+ const index_t chunk=4096;
+ vector<double> buffer(chunk*stride);
+ vector<double> dder(nvar);
+ for(index_t i=0;i<grid->maxsize_;i+=chunk){
+   index_t n=std::min(chunk,grid->maxsize_-i);
+   if(fread(&buffer[0],sizeof(double),n*stride,fp)!=n*stride) plumed_merror("error reading binary grid file " + filename);
+   for(index_t j=0;j<n;++j){
+     if(doder){
+       for(unsigned k=0;k<nvar;++k) dder[k]=buffer[j*stride+1+k];
+       grid->setValueAndDerivatives(i+j,buffer[j*stride],dder);
+     } else grid->setValue(i+j,buffer[j*stride]);
+   }
+ }
+ std::fclose(fp);
+ return grid;
+}
+
+Grid* Grid::getDenseCopy() const {
+// recover the arguments used to construct this grid
+ vector<unsigned> nbin(nbin_);
+ for(unsigned i=0;i<dimension_;++i) if(!pbc_[i]) nbin[i]-=1;
+ Grid* grid=new Grid(funcname,argnames,str_min_,str_max_,nbin,dospline_,usederiv_,true,pbc_,str_min_,str_max_);
+ grid->fmt_=fmt_;
+ vector<double> der(dimension_);
+ for(index_t i=0;i<maxsize_;++i){
+   if(usederiv_){
+     double f=getValueAndDerivatives(i,der);
+     grid->setValueAndDerivatives(i,f,der);
+   } else grid->setValue(i,getValue(i));
+ }
+ return grid;
+}
+
 // Sparse version of grid with map
 void SparseGrid::clear(){
  map_.clear();
@@ -800,6 +966,302 @@ void SparseGrid::writeToFile(OFile& ofile){
 }
 
 
+// Grid in shared memory
+struct SharedGrid::Header{
+// 0: layout not yet written, 1: layout written, 2: initial content ready
+ std::atomic<int> status;
+// number of processes mapping the segment
+ std::atomic<int> nattached;
+// pid of the process that created the segment
+ std::atomic<int> creator;
+ unsigned long long npoints;
+ unsigned dimension;
+ unsigned usederiv;
+// pids of the processes mapping the segment (0 for free slots), used to detect
+// segments that were left behind by simulations that did not terminate properly
+ static const unsigned maxpids=256;
+ std::atomic<int> pids[maxpids];
+};
+
+// grid data starts at a cache line boundary
+const size_t SharedGrid::headerSize_=(sizeof(SharedGrid::Header)+63)/64*64;
+
+static inline std::atomic<double> & sharedGridElement(double*ptr){
+ return *reinterpret_cast<std::atomic<double>*>(ptr);
+}
+
+#ifdef __PLUMED_GRID_HAS_SHM
+static bool processIsAlive(int pid){
+// EPERM means that the process exists but belongs to someone else
+ return kill(pid,0)==0 || errno!=ESRCH;
+}
+#endif
+
+SharedGrid::SharedGrid(const std::string& funcl, const std::vector<Value*> & args, const std::vector<std::string> & gmin,
+                       const std::vector<std::string> & gmax, const std::vector<unsigned> & nbin, bool dospline, bool usederiv,
+                       const std::string & shmname):
+ Grid(funcl,args,gmin,gmax,nbin,dospline,usederiv,false),
+ shmname_(shmname),
+ header_(NULL),
+ data_(NULL),
+ mapsize_(0),
+ creator_(false),
+ pidslot_(-1)
+{
+ plumed_assert(sizeof(std::atomic<double>)==sizeof(double));
+// values are shared between processes, so their atomics cannot rely on a lock local to this process
+ std::atomic<double> testdouble(0.0);
+ std::atomic<int> testint(0);
+ if(!testdouble.is_lock_free() || !testint.is_lock_free())
+   plumed_merror("shared memory grids require lock-free atomic operations on double, which are not available on this system");
+ if(shmname_.length()==0 || shmname_[0]!='/') shmname_="/"+shmname_;
+ const size_t stride=(usederiv_?1+dimension_:1);
+ mapsize_=headerSize_+maxsize_*stride*sizeof(double);
+#ifdef __PLUMED_GRID_HAS_SHM
+ const std::string stale="shared memory segment " + shmname_ + " was left behind by a simulation that did not terminate properly, "
+                         "remove /dev/shm" + shmname_ + " and start again";
+// the last process detaching from a segment might be removing it right now,
+// in which case we wait for it to be gone and create a new one
+ for(unsigned attempt=0;;++attempt){
+   plumed_massert(attempt<10000,"shared memory segment " + shmname_ + " is being removed but does not disappear; " + stale);
+   int fd=shm_open(shmname_.c_str(),O_RDWR|O_CREAT|O_EXCL,0600);
+   if(fd>=0){
+     creator_=true;
+     if(ftruncate(fd,mapsize_)!=0){
+       close(fd); shm_unlink(shmname_.c_str());
+       plumed_merror("cannot resize shared memory segment " + shmname_ + ": " + std::strerror(errno));
+     }
+   } else {
+     plumed_massert(errno==EEXIST,"cannot create shared memory segment " + shmname_ + ": " + std::strerror(errno));
+     fd=shm_open(shmname_.c_str(),O_RDWR,0600);
+     if(fd<0 && errno==ENOENT){ usleep(1000); continue; }
+     plumed_massert(fd>=0,"cannot open shared memory segment " + shmname_ + ": " + std::strerror(errno));
+// the creator might not have resized the segment yet
+     struct stat st;
+     for(unsigned i=0;;++i){
+       plumed_massert(fstat(fd,&st)==0,"cannot stat shared memory segment " + shmname_);
+       if(st.st_size!=0) break;
+       if(i>=60000){ close(fd); plumed_merror(stale); }
+       usleep(1000);
+     }
+     if(static_cast<size_t>(st.st_size)!=mapsize_){
+       close(fd);
+       plumed_merror("shared memory segment " + shmname_ + " has a size which is not compatible with this grid");
+     }
+   }
+   void* ptr=mmap(NULL,mapsize_,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+   close(fd);
+   plumed_massert(ptr!=MAP_FAILED,"cannot map shared memory segment " + shmname_ + ": " + std::strerror(errno));
+   header_=static_cast<Header*>(ptr);
+   data_=reinterpret_cast<double*>(static_cast<char*>(ptr)+headerSize_);
+   if(creator_){
+// a freshly truncated segment is filled with zeros, which is also the initial value of the grid
+     header_->creator.store(getpid());
+     header_->npoints=maxsize_;
+     header_->dimension=dimension_;
+     header_->usederiv=usederiv_;
+     header_->nattached.store(1);
+     registerPid();
+     header_->status.store(1);
+     break;
+   }
+   for(unsigned i=0;header_->status.load()<1;++i){
+     const int creator=header_->creator.load();
+     if((creator!=0 && !processIsAlive(creator)) || (creator==0 && i>=60000)){
+       munmap(header_,mapsize_); header_=NULL;
+       plumed_merror(stale);
+     }
+     usleep(1000);
+   }
+   int n=header_->nattached.load();
+   while(n>0 && !header_->nattached.compare_exchange_weak(n,n+1));
+   if(n==0){
+// the segment is being removed
+     munmap(header_,mapsize_); header_=NULL; data_=NULL;
+     usleep(1000);
+     continue;
+   }
+   if(!(header_->npoints==maxsize_ && header_->dimension==dimension_ && header_->usederiv==(usederiv_?1u:0u))){
+     detach();
+     plumed_merror("shared memory segment " + shmname_ + " contains a grid which is not compatible with this one");
+   }
+// if none of the registered processes is alive the segment is stale
+   bool alive=false, full=true;
+   for(unsigned i=0;i<Header::maxpids;++i){
+     const int pid=header_->pids[i].load();
+     if(pid==0) full=false;
+     else if(processIsAlive(pid)) { alive=true; break; }
+   }
+   if(!alive && !full){
+     detach();
+     plumed_merror(stale);
+   }
+   registerPid();
+   break;
+ }
+#else
+ plumed_merror("shared memory grids are not supported on this system");
+#endif
+}
+
+void SharedGrid::registerPid(){
+ const int pid=getpid();
+ for(unsigned i=0;i<Header::maxpids;++i){
+   int expected=0;
+   if(header_->pids[i].compare_exchange_strong(expected,pid)){ pidslot_=i; return; }
+ }
+// with too many processes the segment cannot be checked for staleness, which is harmless
+}
+
+void SharedGrid::detach(){
+#ifdef __PLUMED_GRID_HAS_SHM
+ if(!header_) return;
+ if(pidslot_>=0) header_->pids[pidslot_].store(0);
+ pidslot_=-1;
+ const bool last=(--header_->nattached==0);
+ munmap(header_,mapsize_);
+ header_=NULL;
+ data_=NULL;
+ if(last) shm_unlink(shmname_.c_str());
+#endif
+}
+
+SharedGrid::~SharedGrid(){
+ detach();
+}
+
+void SharedGrid::setReady(){
+ plumed_assert(creator_);
+ header_->status.store(2);
+}
+
+void SharedGrid::waitReady(){
+#ifdef __PLUMED_GRID_HAS_SHM
+ while(header_->status.load()<2){
+   if(!processIsAlive(header_->creator.load())){
+     detach();
+     plumed_merror("the process that created shared memory segment " + shmname_ + " terminated before initializing it");
+   }
+   usleep(1000);
+ }
+#endif
+}
+
+// atomically replace the element pointed by ptr with f(element), so that additions done
+// at the same time by other processes are not lost
+template <class F>
+static inline void atomicUpdate(double* ptr,const F& f){
+ std::atomic<double> & a(sharedGridElement(ptr));
+ double old=a.load(std::memory_order_relaxed);
+ while(!a.compare_exchange_weak(old,f(old),std::memory_order_relaxed));
+}
+
+void SharedGrid::atomicAdd(double* ptr,double value){
+ std::atomic<double> & a(sharedGridElement(ptr));
+ double old=a.load(std::memory_order_relaxed);
+ while(!a.compare_exchange_weak(old,old+value,std::memory_order_relaxed));
+}
+
+Grid::index_t SharedGrid::getSize() const {
+ return maxsize_;
+}
+
+double SharedGrid::getValue(index_t index) const {
+ plumed_dbg_assert(index<maxsize_);
+ const size_t stride=(usederiv_?1+dimension_:1);
+ return sharedGridElement(data_+index*stride).load(std::memory_order_relaxed);
+}
+
+double SharedGrid::getMinValue() const {
+ double minval=DBL_MAX;
+ for(index_t i=0;i<maxsize_;++i){
+   double v=getValue(i);
+   if(v<minval)minval=v;
+ }
+ return minval;
+}
+
+double SharedGrid::getMaxValue() const {
+ double maxval=-DBL_MAX;
+ for(index_t i=0;i<maxsize_;++i){
+   double v=getValue(i);
+   if(v>maxval)maxval=v;
+ }
+ return maxval;
+}
+
+double SharedGrid::getValueAndDerivatives
+ (index_t index, vector<double>& der) const{
+ plumed_dbg_assert(index<maxsize_ && usederiv_ && der.size()==dimension_);
+ double* p=data_+index*(1+dimension_);
+ for(unsigned int i=0;i<dimension_;++i) der[i]=sharedGridElement(p+1+i).load(std::memory_order_relaxed);
+ return sharedGridElement(p).load(std::memory_order_relaxed);
+}
+
+void SharedGrid::setValue(index_t index, double value){
+ plumed_dbg_assert(index<maxsize_ && !usederiv_);
+ sharedGridElement(data_+index).store(value,std::memory_order_relaxed);
+}
+
+void SharedGrid::setValueAndDerivatives
+ (index_t index, double value, vector<double>& der){
+ plumed_dbg_assert(index<maxsize_ && usederiv_ && der.size()==dimension_);
+ double* p=data_+index*(1+dimension_);
+ sharedGridElement(p).store(value,std::memory_order_relaxed);
+ for(unsigned int i=0;i<dimension_;++i) sharedGridElement(p+1+i).store(der[i],std::memory_order_relaxed);
+}
+
+void SharedGrid::addValue(index_t index, double value){
+ plumed_dbg_assert(index<maxsize_ && !usederiv_);
+ atomicAdd(data_+index,value);
+}
+
+void SharedGrid::addValueAndDerivatives
+ (index_t index, double value, vector<double>& der){
+ plumed_dbg_assert(index<maxsize_ && usederiv_ && der.size()==dimension_);
+ double* p=data_+index*(1+dimension_);
+ atomicAdd(p,value);
+ for(unsigned int i=0;i<dimension_;++i) atomicAdd(p+1+i,der[i]);
+}
+
+void SharedGrid::scaleAllValuesAndDerivatives( const double& scalef ){
+ const size_t n=maxsize_*(usederiv_?1+dimension_:1);
+ for(size_t i=0;i<n;++i) atomicUpdate(data_+i,[scalef](double v){return v*scalef;});
+}
+
+void SharedGrid::logAllValuesAndDerivatives( const double& scalef ){
+ const size_t stride=(usederiv_?1+dimension_:1);
+ for(index_t i=0;i<maxsize_;++i){
+   atomicUpdate(data_+i*stride,[scalef](double v){return scalef*log(v);});
+   for(unsigned j=1;j<stride;++j) atomicUpdate(data_+i*stride+j,[scalef](double v){return scalef/v;});
+ }
+}
+
+void SharedGrid::setMinToZero(){
+ const double min=getMinValue();
+ const size_t stride=(usederiv_?1+dimension_:1);
+ for(index_t i=0;i<maxsize_;++i) atomicAdd(data_+i*stride,-min);
+}
+
+void SharedGrid::applyFunctionAllValuesAndDerivatives( double (*func)(double val), double (*funcder)(double valder) ){
+ const size_t stride=(usederiv_?1+dimension_:1);
+ for(index_t i=0;i<maxsize_;++i){
+   atomicUpdate(data_+i*stride,func);
+   for(unsigned j=1;j<stride;++j) atomicUpdate(data_+i*stride+j,funcder);
+ }
+}
+
+void SharedGrid::clear(){
+// the base constructor does not clear, the segment is initialized when it is created
+ if(!data_) return;
+ const size_t n=maxsize_*(usederiv_?1+dimension_:1);
+ for(size_t i=0;i<n;++i) sharedGridElement(data_+i).store(0.0,std::memory_order_relaxed);
+}
+
+void SharedGrid::mpiSumValuesAndDerivatives( Communicator& ){
+ plumed_merror("mpiSumValuesAndDerivatives cannot be used on a grid in shared memory, whose values are already shared");
+}
+
 void Grid::projectOnLowDimension(double &val, std::vector<int> &vHigh, WeightBase * ptr2obj ){
     unsigned i=0;
     for(i=0;i<vHigh.size();i++){
@@ -155,6 +155,14 @@ public:
  static Grid* create(const std::string&,const std::vector<Value*>&, IFile&,
                      const std::vector<std::string>&,const std::vector<std::string>&,
                      const std::vector<unsigned>&,bool,bool,bool); 
+/// read grid from a binary file written with writeBinary
+ static Grid* createFromBinary(const std::string&,const std::vector<Value*>&,const std::string&,bool,bool,bool);
+/// read grid from a binary file and check boundaries are what is expected from input
+ static Grid* createFromBinary(const std::string&,const std::vector<Value*>&,const std::string&,
+                               const std::vector<std::string>&,const std::vector<std::string>&,
+                               const std::vector<unsigned>&,bool,bool,bool);
+/// check if a file contains a grid written with writeBinary
+ static bool isBinaryFile(const std::string&);
 /// get grid size
  virtual index_t getSize() const;
 /// get grid value
@@ -199,6 +207,10 @@ public:
 
 /// dump grid on file
  virtual void writeToFile(OFile&);
+/// dump grid on a binary file, which can be read back with createFromBinary
+ void writeBinary(const std::string&) const;
+/// get a dense copy of this grid, e.g. to write a snapshot while this grid is still being modified
+ Grid* getDenseCopy() const;
 /// dump grid to gaussian cube file
  void writeCubeFile(OFile&, const double& lunit);
 
@@ -213,7 +225,7 @@ public:
 /// Integrate the function calculated on the grid
  double integrate( std::vector<unsigned>& npoints );
 ///
- void mpiSumValuesAndDerivatives( Communicator& comm );
+ virtual void mpiSumValuesAndDerivatives( Communicator& comm );
 };
 
   
@@ -262,6 +274,84 @@ class SparseGrid : public Grid
 
  virtual ~SparseGrid(){}
 };
+
+/// \ingroup TOOLBOX
+/// Grid stored in a POSIX shared memory segment.
+/// All the processes running on the same node that construct a SharedGrid with the same
+/// name map the same values and derivatives. Additions are atomic, so that several processes
+/// can deposit on the grid concurrently. The first process that constructs the grid creates
+/// the segment and is in charge of initializing it; the segment is removed when the last
+/// process releases it. A segment left behind by processes that terminated without releasing
+/// it is detected when attaching and reported as an error.
+class SharedGrid : public Grid
+{
+ struct Header;
+/// size of the header, data follow
+ static const size_t headerSize_;
+ std::string shmname_;
+ Header* header_;
+ double* data_;
+ size_t mapsize_;
+ bool creator_;
+/// slot of this process in the table of attached processes, -1 if none
+ int pidslot_;
+/// atomically add value to the element pointed by ptr
+ static void atomicAdd(double* ptr,double value);
+/// record this process in the table of attached processes
+ void registerPid();
+/// release the segment, removing it if this is the last process using it
+ void detach();
+
+ public:
+ SharedGrid(const std::string& funcl, const std::vector<Value*> & args, const std::vector<std::string> & gmin,
+            const std::vector<std::string> & gmax, const std::vector<unsigned> & nbin, bool dospline, bool usederiv,
+            const std::string & shmname);
+/// true if this process created the shared segment
+ bool isCreator() const {return creator_;}
+/// to be called by the creator when the initial content of the grid is ready
+ void setReady();
+/// wait until the creator has initialized the grid
+ void waitReady();
+
+ using Grid::getValue;
+ using Grid::getValueAndDerivatives;
+ using Grid::setValue;
+ using Grid::setValueAndDerivatives;
+ using Grid::addValue;
+ using Grid::addValueAndDerivatives;
+
+ index_t getSize() const;
+/// get grid value
+ double getValue(index_t index) const;
+/// get minimum value
+ double getMinValue() const;
+/// get maximum value
+ double getMaxValue() const;
+/// get grid value and derivatives
+ double getValueAndDerivatives(index_t index, std::vector<double>& der) const;
+/// set grid value
+ void setValue(index_t index, double value);
+/// set grid value and derivatives
+ void setValueAndDerivatives(index_t index, double value, std::vector<double>& der);
+/// add to grid value
+ void addValue(index_t index, double value);
+/// add to grid value and derivatives
+ void addValueAndDerivatives(index_t index, double value, std::vector<double>& der);
+/// Scale all grid values and derivatives by a constant factor
+ void scaleAllValuesAndDerivatives( const double& scalef );
+/// Takes the scalef times the logarithm of all grid values and derivatives
+ void logAllValuesAndDerivatives( const double& scalef );
+/// Set the minimum value of the grid to zero and translates accordingly
+ void setMinToZero();
+/// apply function: takes  pointer to  function that accepts a double and apply
+ void applyFunctionAllValuesAndDerivatives( double (*func)(double val), double (*funcder)(double valder) );
+/// clear grid
+ void clear();
+/// not available, the values are already shared by all the processes mapping the segment
+ void mpiSumValuesAndDerivatives( Communicator& comm );
+
+ ~SharedGrid();
+};
 }
 
 #endif
@@ -54,6 +54,8 @@ public:
   double getCutoff( const double& width ) const ;
 /// Get the position of the center 
   std::vector<double> getCenter() const;
+/// Get the height of the kernel
+  double getHeight() const;
 /// Get the support
   std::vector<unsigned> getSupport( const std::vector<double>& dx ) const; 
 /// get it in continuous form
@@ -86,5 +88,10 @@ std::vector<double> KernelFunctions::getCenter() const {
   return center;
 }
 
+inline
+double KernelFunctions::getHeight() const {
+  return height;
+}
+
 }
 #endif
@@ -47,19 +47,22 @@ void LinkCells::buildCellLists( const std::vector<Vector>& pos, const std::vecto
 
   // Must be able to check that pbcs are not nonsensical in some way?? -- GAT
 
-  // Setup the pbc object by copying it from action
-  mypbc.setBox( pbc.getBox() );
+  // Setup the pbc object by copying it from action.  This is expensive for
+  // non orthorhombic boxes so it is only done when the box changes
+  bool samebox=mypbc.isSet();
+  for(unsigned i=0;i<3 && samebox;++i) for(unsigned j=0;j<3;++j) if( mypbc.getBox()(i,j)!=pbc.getBox()(i,j) ) samebox=false;
+  if( !samebox ) mypbc.setBox( pbc.getBox() );
 
   // Setup the lists
   if( pos.size()!=allcells.size() ){ 
     allcells.resize( pos.size() ); lcell_lists.resize( pos.size() ); 
   }
 
-   {
 // This is the reciprocal lattice
 // notice that reciprocal.getRow(0) is a vector that is orthogonal to b and c
 // This allows to use linked cells in non orthorhomic boxes
-     Tensor reciprocal(transpose(mypbc.getInvBox()));
+  Tensor reciprocal(transpose(mypbc.getInvBox()));
+  {
      ncells[0] = std::floor( 1.0/ reciprocal.getRow(0).modulo() / link_cutoff );
      if( ncells[0]==0 ) ncells[0]=1;
      ncells[1] = std::floor( 1.0/ reciprocal.getRow(1).modulo() / link_cutoff );
@@ -83,7 +86,7 @@ void LinkCells::buildCellLists( const std::vector<Vector>& pos, const std::vecto
   // Find out what cell everyone is in
   unsigned rank=comm.Get_rank(), size=comm.Get_size();
   for(unsigned i=rank;i<pos.size();i+=size){
-      allcells[i]=findCell( pos[i] );
+      allcells[i]=findCell( matmul( reciprocal, pos[i] ) );
       lcell_tots[allcells[i]]++;
   }
   // And gather all this information on every node
@@ -108,7 +111,7 @@ void LinkCells::buildCellLists( const std::vector<Vector>& pos, const std::vecto
 
 void LinkCells::retrieveNeighboringAtoms( const Vector& pos, unsigned& natomsper, std::vector<unsigned>& atoms ) const {
   plumed_assert( natomsper==1 || natomsper==2 );  // This is really a bug. If you are trying to reuse this ask GAT for help
-  std::vector<unsigned> celn( findMyCell( pos ) );
+  unsigned celn[3]; findMyCell( mypbc.realToScaled( pos ), celn );
 
   for(int nx=LINKC_MIN(ncells[0]);nx<LINKC_MAX(ncells[0]);++nx){
      int xval = celn[0] + nx;  
@@ -133,17 +136,15 @@ void LinkCells::retrieveNeighboringAtoms( const Vector& pos, unsigned& natomsper
   }
 }
 
-std::vector<unsigned> LinkCells::findMyCell( const Vector& pos ) const {
-  Vector fpos=mypbc.realToScaled( pos ); std::vector<unsigned> celn(3);
+void LinkCells::findMyCell( const Vector& fpos, unsigned* celn ) const {
   for(unsigned j=0;j<3;++j){
      celn[j] = std::floor( ( Tools::pbc(fpos[j]) + 0.5 ) * ncells[j] );
      plumed_assert( celn[j]>=0 && celn[j]<ncells[j] ); // Check that atom is in box  
   }
-  return celn;
 }
 
-unsigned LinkCells::findCell( const Vector& pos ) const {
-  std::vector<unsigned> celn( findMyCell(pos ) );
+unsigned LinkCells::findCell( const Vector& fpos ) const {
+  unsigned celn[3]; findMyCell( fpos, celn );
   return celn[0]*nstride[0] + celn[1]*nstride[1] + celn[2]*nstride[2];
 }
 
@@ -54,10 +54,10 @@ private:
   std::vector<unsigned> lcell_tots;
 /// The atoms ordered by link cells
   std::vector<unsigned> lcell_lists;
-/// Find the cell in which this position is contained
-  std::vector<unsigned> findMyCell( const Vector& pos ) const ;
-/// Find the cell in which this position is contained
-  unsigned findCell( const Vector& pos ) const ;
+/// Find the cell in which this position (in scaled coordinates) is contained
+  void findMyCell( const Vector& fpos, unsigned* celn ) const ;
+/// Find the index of the cell in which this position (in scaled coordinates) is contained
+  unsigned findCell( const Vector& fpos ) const ;
 public:
 ///
   explicit LinkCells( Communicator& comm );
@@ -96,18 +96,21 @@ void NeighborList::update(const vector<Vector>& positions) {
  const double d2=distance_*distance_;
 // check if positions array has the correct length 
  plumed_assert(positions.size()==fullatomlist_.size());
- for(unsigned int i=0;i<nallpairs_;++i){
-   pair<unsigned,unsigned> index=getIndexPair(i);
-   unsigned index0=index.first;
-   unsigned index1=index.second;
-   Vector distance;
-   if(do_pbc_){
-    distance=pbc_->distance(positions[index0],positions[index1]);
-   } else {
-    distance=delta(positions[index0],positions[index1]);
+// pairs are processed in blocks, so that pbc can be applied to all the distances in a block at once
+ const unsigned nblock=256;
+ vector<Vector> distances(nblock);
+ vector<pair<unsigned,unsigned> > indices(nblock);
+ for(unsigned int ib=0;ib<nallpairs_;ib+=nblock){
+   const unsigned nb=(ib+nblock<nallpairs_ ? nblock : nallpairs_-ib);
+   for(unsigned j=0;j<nb;++j){
+     indices[j]=getIndexPair(ib+j);
+     distances[j]=delta(positions[indices[j].first],positions[indices[j].second]);
+   }
+   if(do_pbc_) pbc_->apply(distances,nb);
+   for(unsigned j=0;j<nb;++j){
+     double value=modulo2(distances[j]);
+     if(value<=d2) {neighbors_.push_back(indices[j]);} 
    }
-   double value=modulo2(distance);
-   if(value<=d2) {neighbors_.push_back(index);} 
  }
  setRequestList();
 }
@@ -23,6 +23,9 @@
 #include "OpenMP.h"
 #include "Tools.h"
 #include <cstdlib>
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
 
 namespace PLMD{
 
@@ -38,6 +41,14 @@ unsigned OpenMP::getNumThreads(){
   return numThreads;
 }
 
+unsigned OpenMP::getThreadNum(){
+#if defined(_OPENMP)
+  return omp_get_thread_num();
+#else
+  return 0;
+#endif
+}
+
 
 }
 
@@ -36,6 +36,9 @@ static unsigned getNumThreads();
 /// get cacheline size
 static unsigned getCachelineSize();
 
+/// Get the index of the calling thread (0 outside of parallel regions)
+static unsigned getThreadNum();
+
 /// Get a reasonable number of threads so as to access to an array of size s located at x
 template<typename T>
 static unsigned getGoodNumThreads(const T*x,unsigned s);
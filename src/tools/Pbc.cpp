@@ -29,6 +29,15 @@
 
 namespace PLMD{
 
+namespace {
+/// Vectors for which shifts have to be attempted in Pbc::apply.
+/// Each thread has its own copy.
+std::vector<unsigned>& getShiftList(){
+  static thread_local std::vector<unsigned> toshift;
+  return toshift;
+}
+}
+
 Pbc::Pbc():
   type(unset)
 {
@@ -169,10 +178,53 @@ void Pbc::apply(std::vector<Vector>& dlist, unsigned max_index) const {
       while(dlist[k][2]<=mdiag[2])  dlist[k][2]+=diag[2];      
  }
 #else
-   for(unsigned k=0;k<max_index;++k) for(int i=0;i<3;i++) dlist[k][i]=Tools::pbc(dlist[k][i]*invBox(i,i))*box(i,i);
+   const double b0=box(0,0), b1=box(1,1), b2=box(2,2);
+   const double ib0=invBox(0,0), ib1=invBox(1,1), ib2=invBox(2,2);
+   for(unsigned k=0;k<max_index;++k){
+      dlist[k][0]=Tools::pbc(dlist[k][0]*ib0)*b0;
+      dlist[k][1]=Tools::pbc(dlist[k][1]*ib1)*b1;
+      dlist[k][2]=Tools::pbc(dlist[k][2]*ib2)*b2;
+   }
 #endif
   } else if(type==generic) {
-   for(unsigned k=0;k<max_index;++k) dlist[k]=distance(Vector(0.0,0.0,0.0),dlist[k]);
+// first bring all the vectors to the -0.5,+0.5 region in scaled coordinates
+// and take note of the ones for which shifts have to be attempted.
+// this is the same as calling distance() on each vector, but the first loop has no branches
+   const double i00=invReduced(0,0), i01=invReduced(0,1), i02=invReduced(0,2);
+   const double i10=invReduced(1,0), i11=invReduced(1,1), i12=invReduced(1,2);
+   const double i20=invReduced(2,0), i21=invReduced(2,1), i22=invReduced(2,2);
+   const double r00=reduced(0,0), r01=reduced(0,1), r02=reduced(0,2);
+   const double r10=reduced(1,0), r11=reduced(1,1), r12=reduced(1,2);
+   const double r20=reduced(2,0), r21=reduced(2,1), r22=reduced(2,2);
+   std::vector<unsigned>& toshift( getShiftList() ); toshift.resize(max_index);
+   unsigned nshift=0;
+   for(unsigned k=0;k<max_index;++k){
+      const double d0=dlist[k][0], d1=dlist[k][1], d2=dlist[k][2];
+      const double s0=Tools::pbc(d0*i00+d1*i10+d2*i20);
+      const double s1=Tools::pbc(d0*i01+d1*i11+d2*i21);
+      const double s2=Tools::pbc(d0*i02+d1*i12+d2*i22);
+      dlist[k][0]=s0*r00+s1*r10+s2*r20;
+      dlist[k][1]=s0*r01+s1*r11+s2*r21;
+      dlist[k][2]=s0*r02+s1*r12+s2*r22;
+      toshift[nshift]=8*k+(s0>0?4:0)+(s1>0?2:0)+(s2>0?1:0);
+      nshift+=(std::fabs(s0)+std::fabs(s1)+std::fabs(s2)>0.5);
+   }
+// then try the shifts that are specific for the "octant" of each vector
+   for(unsigned j=0;j<nshift;++j){
+      const unsigned k=toshift[j]/8, oct=toshift[j]%8;
+      const std::vector<Vector> & myshifts(shifts[oct/4][(oct/2)%2][oct%2]);
+      const double d0=dlist[k][0], d1=dlist[k][1], d2=dlist[k][2];
+      double lbest=d0*d0+d1*d1+d2*d2; unsigned ibest=myshifts.size();
+      for(unsigned i=0;i<myshifts.size();i++){
+        const double t0=d0+myshifts[i][0], t1=d1+myshifts[i][1], t2=d2+myshifts[i][2];
+        const double ltrial=t0*t0+t1*t1+t2*t2;
+        if(ltrial<lbest){
+          lbest=ltrial;
+          ibest=i;
+        }
+      }
+      if(ibest<myshifts.size()) dlist[k]+=myshifts[ibest];
+   }
   } else plumed_merror("unknown pbc type");
 }
 
@@ -0,0 +1,245 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2016 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#include "RMSDBatch.h"
+#include "Exception.h"
+#include "Matrix.h"
+#include <cmath>
+
+namespace PLMD{
+
+namespace {
+/// Workspace used when the distances from all the references are computed.  Each
+/// thread has its own copy so that no memory is allocated in the calculation.
+struct BatchScratch {
+  std::vector<Vector> centered;
+  std::vector<double> cov;
+};
+
+BatchScratch& getBatchScratch(){
+  static thread_local BatchScratch scratch;
+  return scratch;
+}
+
+double det3( const double& a00, const double& a01, const double& a02,
+             const double& a10, const double& a11, const double& a12,
+             const double& a20, const double& a21, const double& a22 ){
+  return a00*(a11*a22-a12*a21) - a01*(a10*a22-a12*a20) + a02*(a10*a21-a11*a20);
+}
+
+/// Cofactor (i,j) of a 4x4 matrix
+double cofactor4( const double a[4][4], const unsigned& i, const unsigned& j ){
+  unsigned r[3], c[3];
+  for(unsigned k=0,n=0;k<4;++k) if(k!=i) r[n++]=k;
+  for(unsigned k=0,n=0;k<4;++k) if(k!=j) c[n++]=k;
+  double d=det3( a[r[0]][c[0]], a[r[0]][c[1]], a[r[0]][c[2]],
+                 a[r[1]][c[0]], a[r[1]][c[1]], a[r[1]][c[2]],
+                 a[r[2]][c[0]], a[r[2]][c[1]], a[r[2]][c[2]] );
+  return ((i+j)%2==0) ? d : -d;
+}
+}
+
+RMSDBatch::RMSDBatch():
+natoms(0),
+nref(0)
+{
+}
+
+void RMSDBatch::clear(){
+  natoms=0; nref=0;
+  align.clear(); ref.clear(); rr11.clear();
+}
+
+bool RMSDBatch::sameWeights( const std::vector<double>& weights ) const {
+  if( weights.size()!=natoms ) return false;
+  double wsum=0; for(unsigned i=0;i<natoms;++i) wsum+=weights[i];
+  for(unsigned i=0;i<natoms;++i){
+     if( weights[i]/wsum!=align[i] ) return false;
+  }
+  return true;
+}
+
+void RMSDBatch::addReference( const std::vector<double>& weights, const std::vector<Vector>& reference ){
+  plumed_massert( weights.size()==reference.size(), "mismatch in dimension of reference/weights arrays" );
+  if( nref==0 ){
+     natoms=reference.size(); align.resize( natoms );
+     double wsum=0; for(unsigned i=0;i<natoms;++i) wsum+=weights[i];
+     for(unsigned i=0;i<natoms;++i) align[i]=weights[i]/wsum;
+  }
+  plumed_massert( sameWeights( weights ), "all the references in an RMSDBatch should have the same atoms and weights" );
+
+  Vector cref;
+  for(unsigned i=0;i<natoms;++i) cref+=align[i]*reference[i];
+
+  // Repack the references so that the new one is at the end of each block
+  std::vector<double> newref( 3*natoms*(nref+1) );
+  for(unsigned iat=0;iat<natoms;++iat){
+     for(unsigned k=0;k<nref;++k) for(unsigned i=0;i<3;++i) newref[3*(iat*(nref+1)+k)+i]=ref[3*(iat*nref+k)+i];
+     Vector y=reference[iat]-cref;
+     for(unsigned i=0;i<3;++i) newref[3*(iat*(nref+1)+nref)+i]=y[i];
+  }
+  ref.swap( newref );
+
+  double r=0; for(unsigned iat=0;iat<natoms;++iat) r+=align[iat]*modulo2( reference[iat]-cref );
+  rr11.push_back( r ); nref++;
+}
+
+void RMSDBatch::center( const std::vector<Vector>& positions, std::vector<Vector>& centered ) const {
+  plumed_dbg_assert( positions.size()==natoms );
+  Vector cpos;
+  for(unsigned iat=0;iat<natoms;++iat) cpos+=align[iat]*positions[iat];
+  if( centered.size()!=natoms ) centered.resize( natoms );
+  for(unsigned iat=0;iat<natoms;++iat) centered[iat]=positions[iat]-cpos;
+}
+
+double RMSDBatch::lowestEigenvalue( const Tensor& rr01, const double& bound, Vector4d* q ){
+  // This is the quaternion matrix used in RMSD::optimalAlignment
+  double m[4][4];
+  m[0][0]=2.0*(-rr01[0][0]-rr01[1][1]-rr01[2][2]);
+  m[1][1]=2.0*(-rr01[0][0]+rr01[1][1]+rr01[2][2]);
+  m[2][2]=2.0*(+rr01[0][0]-rr01[1][1]+rr01[2][2]);
+  m[3][3]=2.0*(+rr01[0][0]+rr01[1][1]-rr01[2][2]);
+  m[0][1]=2.0*(-rr01[1][2]+rr01[2][1]);
+  m[0][2]=2.0*(+rr01[0][2]-rr01[2][0]);
+  m[0][3]=2.0*(-rr01[0][1]+rr01[1][0]);
+  m[1][2]=2.0*(-rr01[0][1]-rr01[1][0]);
+  m[1][3]=2.0*(-rr01[0][2]-rr01[2][0]);
+  m[2][3]=2.0*(-rr01[1][2]-rr01[2][1]);
+  m[1][0]=m[0][1]; m[2][0]=m[0][2]; m[2][1]=m[1][2];
+  m[3][0]=m[0][3]; m[3][1]=m[1][3]; m[3][2]=m[2][3];
+
+  // The matrix is traceless, so its characteristic polynomial is
+  // x^4 + c2 x^2 + c1 x + c0 with c2=-tr(m^2)/2, c1=-tr(m^3)/3 and c0=det(m)
+  double t2=0, t3=0;
+  for(unsigned i=0;i<4;++i) for(unsigned j=0;j<4;++j){
+     t2+=m[i][j]*m[j][i];
+     double mm=0; for(unsigned k=0;k<4;++k) mm+=m[i][k]*m[k][j];
+     t3+=mm*m[j][i];
+  }
+  double c0=0; for(unsigned j=0;j<4;++j) c0+=m[0][j]*cofactor4( m, 0, j );
+  const double c2=-0.5*t2, c1=-t3/3.0;
+
+  // Since the distance is positive all the eigenvalues are larger than -bound. Starting
+  // from there Newton's method converges monotonically to the lowest eigenvalue
+  double lambda=-bound;
+  for(unsigned iter=0;iter<100;++iter){
+     double l2=lambda*lambda;
+     double p=(l2+c2)*l2+c1*lambda+c0;
+     double dp=(4.0*l2+2.0*c2)*lambda+c1;
+     if( dp==0.0 ) break;
+     double delta=p/dp; lambda-=delta;
+     if( std::fabs(delta)<=1.e-14*bound ) break;
+  }
+  if( !q ) return lambda;
+
+  // The eigenvector is proportional to any non-zero row of the adjugate of m-lambda
+  for(unsigned i=0;i<4;++i) m[i][i]-=lambda;
+  double best=0;
+  for(unsigned i=0;i<4;++i){
+     Vector4d row;
+     for(unsigned j=0;j<4;++j) row[j]=cofactor4( m, i, j );
+     double nn=modulo2( row );
+     if( nn>best ){ best=nn; *q=row; }
+  }
+  // If the lowest eigenvalue is (close to) degenerate the adjugate vanishes and
+  // we fall back to a full diagonalization
+  if( best>1.e-12*bound*bound*bound*bound*bound*bound ){
+     *q/=std::sqrt( best );
+     return lambda;
+  }
+  Matrix<double> mm(4,4);
+  for(unsigned i=0;i<4;++i) for(unsigned j=0;j<4;++j) mm[i][j]=m[i][j]+(i==j?lambda:0.0);
+  std::vector<double> eigenvals; Matrix<double> eigenvecs;
+  int diagerror=diagMat( mm, eigenvals, eigenvecs );
+  if( diagerror!=0 ) plumed_merror("diagonalization of the quaternion matrix failed");
+  for(unsigned j=0;j<4;++j) (*q)[j]=eigenvecs[0][j];
+  return eigenvals[0];
+}
+
+void RMSDBatch::calculate( const std::vector<Vector>& positions, std::vector<double>& dist, bool squared ) const {
+  BatchScratch& bs=getBatchScratch();
+  center( positions, bs.centered );
+  double rr00=0;
+  for(unsigned iat=0;iat<natoms;++iat) rr00+=align[iat]*modulo2( bs.centered[iat] );
+
+  // Correlation matrices with all the references, element (i,j) for reference k is in cov[9*k+3*i+j]
+  bs.cov.assign( 9*nref, 0.0 );
+  double* cov=bs.cov.data();
+  for(unsigned iat=0;iat<natoms;++iat){
+     const double x0=align[iat]*bs.centered[iat][0], x1=align[iat]*bs.centered[iat][1], x2=align[iat]*bs.centered[iat][2];
+     const double* r=&ref[3*iat*nref];
+     for(unsigned k=0;k<nref;++k){
+        const double* y=r+3*k; double* c=cov+9*k;
+        c[0]+=x0*y[0]; c[1]+=x0*y[1]; c[2]+=x0*y[2];
+        c[3]+=x1*y[0]; c[4]+=x1*y[1]; c[5]+=x1*y[2];
+        c[6]+=x2*y[0]; c[7]+=x2*y[1]; c[8]+=x2*y[2];
+     }
+  }
+
+  if( dist.size()!=nref ) dist.resize( nref );
+  for(unsigned k=0;k<nref;++k){
+     const double* c=cov+9*k;
+     Tensor rr01( c[0], c[1], c[2], c[3], c[4], c[5], c[6], c[7], c[8] );
+     double d=lowestEigenvalue( rr01, rr00+rr11[k], NULL )+rr00+rr11[k];
+     if( d<0.0 ) d=0.0;
+     dist[k]=squared ? d : std::sqrt( d );
+  }
+}
+
+double RMSDBatch::calculate( const unsigned& k, const std::vector<Vector>& centered, std::vector<Vector>& derivatives, bool safe, bool squared ) const {
+  plumed_dbg_assert( k<nref && centered.size()==natoms );
+  double rr00=0; Tensor rr01;
+  for(unsigned iat=0;iat<natoms;++iat){
+     const double* y=&ref[3*(iat*nref+k)];
+     rr00+=align[iat]*modulo2( centered[iat] );
+     rr01+=Tensor( align[iat]*centered[iat], Vector( y[0], y[1], y[2] ) );
+  }
+  Vector4d q; double lambda=lowestEigenvalue( rr01, rr00+rr11[k], &q );
+
+  // This is the rotation matrix that brings reference to positions
+  Tensor rotation;
+  rotation[0][0]=q[0]*q[0]+q[1]*q[1]-q[2]*q[2]-q[3]*q[3];
+  rotation[1][1]=q[0]*q[0]-q[1]*q[1]+q[2]*q[2]-q[3]*q[3];
+  rotation[2][2]=q[0]*q[0]-q[1]*q[1]-q[2]*q[2]+q[3]*q[3];
+  rotation[0][1]=2*(+q[0]*q[3]+q[1]*q[2]);
+  rotation[0][2]=2*(-q[0]*q[2]+q[1]*q[3]);
+  rotation[1][2]=2*(+q[0]*q[1]+q[2]*q[3]);
+  rotation[1][0]=2*(-q[0]*q[3]+q[1]*q[2]);
+  rotation[2][0]=2*(+q[0]*q[2]+q[1]*q[3]);
+  rotation[2][1]=2*(-q[0]*q[1]+q[2]*q[3]);
+
+  if( derivatives.size()!=natoms ) derivatives.resize( natoms );
+  double dist=0;
+  for(unsigned iat=0;iat<natoms;++iat){
+     const double* y=&ref[3*(iat*nref+k)];
+     derivatives[iat]=centered[iat]-matmul( rotation, Vector( y[0], y[1], y[2] ) );
+     if( safe ) dist+=align[iat]*modulo2( derivatives[iat] );
+  }
+  if( !safe ) dist=lambda+rr00+rr11[k];
+
+  // There is no need for derivatives of rotation and shift as they are zero by construction
+  double prefactor=1.0;
+  if( !squared ){ dist=std::sqrt( dist ); prefactor=0.5/dist; }
+  for(unsigned iat=0;iat<natoms;++iat) derivatives[iat]*=2*prefactor*align[iat];
+  return dist;
+}
+
+}
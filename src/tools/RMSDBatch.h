@@ -0,0 +1,108 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2016 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#ifndef __PLUMED_tools_RMSDBatch_h
+#define __PLUMED_tools_RMSDBatch_h
+
+#include "Vector.h"
+#include "Tensor.h"
+#include <vector>
+
+namespace PLMD{
+
+/**
+\ingroup TOOLBOX
+A class for calculating the optimal alignment RMSD of one configuration from several
+reference configurations at once.
+
+All the references must contain the same number of atoms and must use the same weights,
+which are used both for the alignment and for the displacement (this is the case
+for \ref RMSD with TYPE=OPTIMAL when occupancy and beta columns are equal).
+The positions are centered only once. The correlation matrices with all the references
+are then accumulated in a single pass over the atoms, using a packed copy of the references.
+The lowest eigenvalue of each quaternion matrix is found with Newton's method on its
+characteristic polynomial, and the eigenvector is obtained from the adjugate matrix,
+so that no call to LAPACK is needed. The same approach is used in the QCP method
+(Theobald, Acta Cryst. A 61, 478 (2005)).
+
+\verbatim
+RMSDBatch batch;
+for(unsigned k=0;k<refs.size();++k) batch.addReference( weights, refs[k] );
+// distances from all the references
+std::vector<double> dist;
+batch.calculate( positions, dist, false );
+// distance and derivatives with respect to one of them
+std::vector<Vector> centered, derivatives;
+batch.center( positions, centered );
+double d=batch.calculate( k, centered, derivatives, true, false );
+\endverbatim
+*/
+class RMSDBatch {
+private:
+/// The number of atoms in each structure
+  unsigned natoms;
+/// The number of reference structures
+  unsigned nref;
+/// The normalized weights of the atoms
+  std::vector<double> align;
+/// The centered reference positions. Coordinate i of atom iat in reference k
+/// is stored in ref[3*(iat*nref+k)+i], so that all the references are read together
+  std::vector<double> ref;
+/// The weighted second moment of each reference
+  std::vector<double> rr11;
+/// Find the lowest eigenvalue of the quaternion matrix built from the correlation matrix
+/// and, if q is not NULL, the corresponding eigenvector
+  static double lowestEigenvalue( const Tensor& rr01, const double& bound, Vector4d* q );
+public:
+  RMSDBatch();
+/// Remove all the references
+  void clear();
+/// Add a reference structure, weights are normalized and the reference is centered
+  void addReference( const std::vector<double>& weights, const std::vector<Vector>& reference );
+/// Get the number of references
+  unsigned getNumberOfReferences() const ;
+/// Get the number of atoms
+  unsigned getNumberOfAtoms() const ;
+/// Check if weights are the same used for the references
+  bool sameWeights( const std::vector<double>& weights ) const ;
+/// Remove the weighted center from a set of positions
+  void center( const std::vector<Vector>& positions, std::vector<Vector>& centered ) const ;
+/// Calculate the distance from all the references
+  void calculate( const std::vector<Vector>& positions, std::vector<double>& dist, bool squared ) const ;
+/// Calculate the distance from reference k and its derivatives with respect to the positions.
+/// Positions should already be centered. If safe is true the distance is computed
+/// from the aligned positions rather than from the eigenvalue, as done by RMSD with TYPE=OPTIMAL
+  double calculate( const unsigned& k, const std::vector<Vector>& centered, std::vector<Vector>& derivatives, bool safe, bool squared ) const ;
+};
+
+inline
+unsigned RMSDBatch::getNumberOfReferences() const {
+  return nref;
+}
+
+inline
+unsigned RMSDBatch::getNumberOfAtoms() const {
+  return natoms;
+}
+
+}
+
+#endif
@@ -27,6 +27,7 @@
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <cmath>
 
 /*
 Different clocks can be used
@@ -108,7 +109,7 @@ const Stopwatch::Time & Stopwatch::Time::operator+=(const Time&t2){
 }
 
 Stopwatch::Watch::Watch():
-  cycles(0),running(0) { }
+  cycles(0),running(0),histogram(nbins,0) { }
 
 void Stopwatch::Watch::start(){
   running++;
@@ -121,9 +122,31 @@ void Stopwatch::Watch::stop(){
   total+=lap;
   if(lap>max)max=lap;
   if(min>lap || cycles==1)min=lap;
+  double t=lap;
+  int ibin=0;
+  if(t>0.0) ibin=int(std::floor((std::log10(t)-minDecade)*binsPerDecade));
+  if(ibin<0) ibin=0;
+  if(ibin>=int(nbins)) ibin=nbins-1;
+  histogram[ibin]++;
   lap.reset();
 } 
 
+double Stopwatch::Watch::percentile(double p)const{
+  if(cycles==0) return 0.0;
+  double target=p*cycles;
+  unsigned count=0;
+  unsigned ibin=0;
+  for(ibin=0;ibin<nbins-1;ibin++){
+    count+=histogram[ibin];
+    if(count>=target) break;
+  }
+// center of the bin on a logarithmic scale, within the observed range
+  double t=std::pow(10.0,minDecade+(ibin+0.5)/binsPerDecade);
+  if(t<double(min)) t=double(min);
+  if(t>double(max)) t=double(max);
+  return t;
+}
+
 void Stopwatch::Watch::pause(){
   plumed_assert(running>0);
   running--;
@@ -131,16 +154,39 @@ void Stopwatch::Watch::pause(){
   lap+=Time::get()-lastStart;
 } 
 
+Stopwatch::Stopwatch(){
+  getHandle("");
+}
+
+unsigned Stopwatch::getHandle(const std::string & name){
+  const auto it=handles.find(name);
+  if(it!=handles.end()) return it->second;
+  unsigned handle=watches.size();
+  watches.push_back(Watch());
+  names.push_back(name);
+  handles[name]=handle;
+  return handle;
+}
+
 void Stopwatch::start(const std::string & name){
-  watches[name].start();
+  start(getHandle(name));
 }
 
 void Stopwatch::stop(const std::string & name){
-  watches[name].stop();
+  stop(getHandle(name));
 }
 
 void Stopwatch::pause(const std::string & name){
-  watches[name].pause();
+  pause(getHandle(name));
+}
+
+std::vector<unsigned> Stopwatch::sortedHandles()const{
+  std::vector<std::pair<std::string,unsigned> > sorted;
+  for(unsigned i=0;i<names.size();i++) sorted.push_back(std::make_pair(names[i],i));
+  std::sort(sorted.begin(),sorted.end());
+  std::vector<unsigned> h;
+  for(const auto & it : sorted) h.push_back(it.second);
+  return h;
 }
 
 
@@ -150,12 +196,10 @@ std::ostream& Stopwatch::log(std::ostream&os)const{
   for(unsigned i=0;i<40;i++) os<<" ";
   os<<"      Cycles        Total      Average      Minumum      Maximum\n";
 
-  std::vector<std::string> names;
-  for(const auto & it : watches) names.push_back(it.first);
-  std::sort(names.begin(),names.end());
-
-  for(const auto & name : names){
-    const Watch&t(watches.find(name)->second);
+  for(const auto & h : sortedHandles()){
+    const Watch&t(watches[h]);
+    if(t.cycles==0) continue;
+    const std::string&name(names[h]);
     os<<name;
     for(unsigned i=name.length();i<40;i++) os<<" ";
     std::sprintf(buffer,"%12u %12.6f %12.6f %12.6f %12.6f\n", t.cycles, double(t.total), double(t.total/t.cycles), double(t.min),double(t.max));
@@ -164,8 +208,39 @@ std::ostream& Stopwatch::log(std::ostream&os)const{
   return os;
 }
 
+void Stopwatch::writeCSV(std::ostream&os)const{
+  char buffer[1000];
+  os<<"name,cycles,total,average,min,max,p50,p90,p99\n";
+  for(const auto & h : sortedHandles()){
+    const Watch&t(watches[h]);
+    if(t.cycles==0) continue;
+    std::string name(names[h]);
+    std::replace(name.begin(),name.end(),'"','\'');
+    std::sprintf(buffer,"%u,%.9f,%.9f,%.9f,%.9f,%.9f,%.9f,%.9f\n", t.cycles, double(t.total), double(t.total)/t.cycles, double(t.min), double(t.max),
+                 t.percentile(0.5), t.percentile(0.9), t.percentile(0.99));
+    os<<"\""<<name<<"\","<<buffer;
+  }
 }
 
+void Stopwatch::writeJSON(std::ostream&os)const{
+  char buffer[1000];
+  os<<"{\n  \"timers\": [";
+  bool first=true;
+  for(const auto & h : sortedHandles()){
+    const Watch&t(watches[h]);
+    if(t.cycles==0) continue;
+    std::string name;
+    for(const auto & c : names[h]){
+      if(c=='"' || c=='\\') name+='\\';
+      name+=c;
+    }
+    std::sprintf(buffer,"\"cycles\": %u, \"total\": %.9f, \"average\": %.9f, \"min\": %.9f, \"max\": %.9f, \"p50\": %.9f, \"p90\": %.9f, \"p99\": %.9f",
+                 t.cycles, double(t.total), double(t.total)/t.cycles, double(t.min), double(t.max),
+                 t.percentile(0.5), t.percentile(0.9), t.percentile(0.99));
+    os<<(first?"\n":",\n")<<"    {\"name\": \""<<name<<"\", "<<buffer<<"}";
+    first=false;
+  }
+  os<<"\n  ]\n}\n";
+}
 
-
-
+}
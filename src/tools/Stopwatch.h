@@ -24,6 +24,7 @@
 
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include <iosfwd>
 
 namespace PLMD{
@@ -93,6 +94,28 @@ int main(){
 
 \endverbatim
 
+When a stopwatch is started and stopped very often the cost of looking up its name
+can be avoided by using an integer handle, which is obtained once with getHandle():
+
+\verbatim
+#include "Stopwatch.h"
+
+int main(){
+  Stopwatch sw;
+  unsigned loop=sw.getHandle("loop");
+  for(int i=0;i<100;i++){
+    sw.start(loop);
+// do calculation
+    sw.stop(loop);
+  }
+  return 0;
+}
+\endverbatim
+
+Besides the average, each stopwatch keeps an histogram of the duration of its cycles,
+which is used to estimate percentiles. All the timers can be written in
+CSV or JSON format with writeCSV() and writeJSON().
+
 */
 
 class Stopwatch{
@@ -114,6 +137,11 @@ class Stopwatch{
 /// Class Stopwatch contains a collection of them
   class Watch{
   public:
+/// Number of bins per decade in the histogram of cycle durations
+    static const unsigned binsPerDecade=20;
+/// The histogram covers durations from 1 ns to 1000 s
+    static const int minDecade=-9;
+    static const unsigned nbins=12*binsPerDecade;
     Watch();
     Time total;
     Time lastStart;
@@ -122,39 +150,79 @@ class Stopwatch{
     Time min;
     unsigned cycles;
     unsigned running;
+    std::vector<unsigned> histogram;
     void start();
     void stop();
     void pause();
+/// Estimate a percentile (0<p<1) of the cycle duration from the histogram
+    double percentile(double p)const;
   };
-  std::unordered_map<std::string,Watch> watches;
+  std::vector<Watch> watches;
+  std::vector<std::string> names;
+  std::unordered_map<std::string,unsigned> handles;
   std::ostream& log(std::ostream&)const;
+/// Handles of the watches sorted by name
+  std::vector<unsigned> sortedHandles()const;
 public:
+  Stopwatch();
+/// Get the handle of timer named "name", creating it if needed
+  unsigned getHandle(const std::string&name);
 /// Start timer named "name"
   void start(const std::string&name);
+  void start(unsigned handle);
   void start();
 /// Stop timer named "name"
   void stop(const std::string&name);
+  void stop(unsigned handle);
   void stop();
 /// Pause timer named "name"
   void pause(const std::string&name);
+  void pause(unsigned handle);
   void pause();
+/// Total time (in seconds) accumulated by the timer with the given handle
+  double getTotal(unsigned handle)const;
+/// Write all timers in CSV format
+  void writeCSV(std::ostream&)const;
+/// Write all timers in JSON format
+  void writeJSON(std::ostream&)const;
 /// Dump all timers on an ostream
   friend std::ostream& operator<<(std::ostream&,const Stopwatch&);
 };
 
+inline
+void Stopwatch::start(unsigned handle){
+  watches[handle].start();
+}
+
+inline
+void Stopwatch::stop(unsigned handle){
+  watches[handle].stop();
+}
+
+inline
+void Stopwatch::pause(unsigned handle){
+  watches[handle].pause();
+}
+
+// the un-named stopwatch always has handle 0
 inline
 void Stopwatch::start(){
-  start("");
+  start(0u);
 }
 
 inline
 void Stopwatch::stop(){
-  stop("");
+  stop(0u);
 }
 
 inline
 void Stopwatch::pause(){
-  pause("");
+  pause(0u);
+}
+
+inline
+double Stopwatch::getTotal(unsigned handle)const{
+  return watches[handle].total;
 }
 
 }
@@ -154,6 +154,124 @@ for backward compatibility. This might change in the future.
 */
 //+ENDPLUMEDOC
 
+/// Specialized implementations of the rational function for a given pair of exponents
+struct SwitchingFunction::Kernels {
+/// Function of a single scaled distance
+  double (*scalar)(double,double&);
+/// Function of an array of squared distances, including cutoff and stretching
+  void (*batch)(unsigned,const double*,double*,double*,double,double,double,double);
+};
+
+namespace {
+
+/// Integer power with the exponent known at compile time.
+/// The multiplications are done in the same order as in Tools::fastpow(),
+/// so that the result is identical, but the loop is unrolled by the compiler.
+template<int exp>
+inline double ipow(double base){
+  double result=1.0;
+  for(int e=exp;e;e>>=1){
+    if(e&1) result*=base;
+    base*=base;
+  }
+  return result;
+}
+
+/// Rational function with exponents known at compile time.
+/// This is the same as SwitchingFunction::do_rational()
+template<int nn,int mm>
+inline double rationalKernel(double rdist,double&dfunc){
+  double result;
+  if(2*nn==mm){
+    double rNdist=ipow<nn-1>(rdist);
+    double iden=1.0/(1+rNdist*rdist);
+    dfunc = -nn*rNdist*iden*iden;
+    result = iden;
+  } else {
+    if(rdist>(1.-100.0*epsilon) && rdist<(1+100.0*epsilon)){
+      result=nn/mm;
+      dfunc=0.5*nn*(nn-mm)/mm;
+    }else{
+      double rNdist=ipow<nn-1>(rdist);
+      double rMdist=ipow<mm-1>(rdist);
+      double num = 1.-rNdist*rdist;
+      double iden = 1./(1.-rMdist*rdist);
+      double func = num*iden;
+      result = func;
+      dfunc = ((-nn*rNdist*iden)+(func*(iden*mm)*rMdist));
+    }
+  }
+  return result;
+}
+
+template<int nn,int mm>
+double rationalScalar(double rdist,double&dfunc){
+  return rationalKernel<nn,mm>(rdist,dfunc);
+}
+
+/// Rational function on an array of squared distances.
+/// The function is computed also beyond dmax and then discarded, so that the loop has no branches
+/// when 2*nn==mm. The result is the same as SwitchingFunction::calculateSqr()
+template<int nn,int mm>
+void rationalBatch(unsigned n,const double*distance2,double*result,double*dfunc,double invr0_2,double dmax_2,double stretch,double shift){
+  const double dfactor=2*invr0_2;
+  for(unsigned i=0;i<n;i++){
+    double df;
+    const double r=rationalKernel<nn,mm>(distance2[i]*invr0_2,df);
+    const bool out=(distance2[i]>dmax_2);
+    result[i]=(out ? 0.0 : r*stretch+shift);
+    dfunc[i]=(out ? 0.0 : df*dfactor*stretch);
+  }
+}
+
+template<int nn,int mm>
+const SwitchingFunction::Kernels* rationalKernels(){
+  static const SwitchingFunction::Kernels kernels={
+    &rationalScalar<nn,mm>,
+    &rationalBatch<nn,mm>
+  };
+  return &kernels;
+}
+
+/// Find the specialized kernels for exponents nn and mm.
+/// Returns NULL if (nn,mm) is not one of the precompiled pairs.
+const SwitchingFunction::Kernels* findRationalKernels(int nn,int mm){
+#define PLUMED_SWITCHING_KERNEL(n,m) if(nn==n && mm==m) return rationalKernels<n,m>();
+  PLUMED_SWITCHING_KERNEL(1,2)
+  PLUMED_SWITCHING_KERNEL(2,4)
+  PLUMED_SWITCHING_KERNEL(3,6)
+  PLUMED_SWITCHING_KERNEL(4,8)
+  PLUMED_SWITCHING_KERNEL(5,10)
+  PLUMED_SWITCHING_KERNEL(6,12)
+  PLUMED_SWITCHING_KERNEL(7,14)
+  PLUMED_SWITCHING_KERNEL(8,16)
+  PLUMED_SWITCHING_KERNEL(10,20)
+  PLUMED_SWITCHING_KERNEL(12,24)
+  PLUMED_SWITCHING_KERNEL(3,5)
+  PLUMED_SWITCHING_KERNEL(4,6)
+  PLUMED_SWITCHING_KERNEL(6,8)
+  PLUMED_SWITCHING_KERNEL(6,10)
+  PLUMED_SWITCHING_KERNEL(8,12)
+  PLUMED_SWITCHING_KERNEL(9,12)
+  PLUMED_SWITCHING_KERNEL(10,12)
+  PLUMED_SWITCHING_KERNEL(5,6)
+#undef PLUMED_SWITCHING_KERNEL
+  return NULL;
+}
+
+/// Scratch space used to evaluate matheval switching functions on arrays of distances
+struct ExpressionBuffers {
+  std::vector<unsigned> index;
+  std::vector<double> rdist, outputs;
+};
+
+ExpressionBuffers& expressionBuffers(){
+  static thread_local ExpressionBuffers buffers;
+  return buffers;
+}
+
+}
+
 void SwitchingFunction::registerKeywords( Keywords& keys ){
   keys.add("compulsory","R_0","the value of R_0 in the switching function");
   keys.add("compulsory","D_0","0.0","the value of D_0 in the switching function");
@@ -254,6 +372,7 @@ void SwitchingFunction::set(const std::string & definition,std::string& errormsg
       return;
     }
     evaluator_deriv=evaluator_derivative(evaluator,const_cast<char*>("x"));
+    expression.set(func,std::vector<std::string>(1,"x"),true);
   }
 #endif
   else errormsg="cannot understand switching function type '"+name+"'";
@@ -262,6 +381,8 @@ void SwitchingFunction::set(const std::string & definition,std::string& errormsg
       for(unsigned i=0;i<data.size();++i) errormsg = errormsg + data[i] + " "; 
   }
 
+  setKernels();
+
   if(dostretch && dmax!=std::numeric_limits<double>::max()){
     double dummy;
     double s0=calculate(0.0,dummy);
@@ -338,14 +459,22 @@ double SwitchingFunction::do_rational(double rdist,double&dfunc,int nn,int mm)co
     return result;
 }
 
+void SwitchingFunction::setKernels(){
+  kernels=NULL;
+  kernels_sqr=NULL;
+  if(type!=rational) return;
+  kernels=findRationalKernels(nn,mm);
+  if(nn%2==0 && mm%2==0 && d0==0.0) kernels_sqr=findRationalKernels(nn/2,mm/2);
+}
+
 double SwitchingFunction::calculateSqr(double distance2,double&dfunc)const{
-  if(type==rational && nn%2==0 && mm%2==0 && d0==0.0){
+  if(kernels_sqr || (type==rational && nn%2==0 && mm%2==0 && d0==0.0)){
     if(distance2>dmax_2){
       dfunc=0.0;
       return 0.0;
     }
     const double rdist_2 = distance2*invr0_2;
-    double result=do_rational(rdist_2,dfunc,nn/2,mm/2);
+    double result=(kernels_sqr ? kernels_sqr->scalar(rdist_2,dfunc) : do_rational(rdist_2,dfunc,nn/2,mm/2));
 // chain rule:
     dfunc*=2*invr0_2;
 // stretch:
@@ -358,6 +487,44 @@ double SwitchingFunction::calculateSqr(double distance2,double&dfunc)const{
   }
 }
 
+void SwitchingFunction::calculateSqr(unsigned n,const double*distance2,double*result,double*dfunc)const{
+  if(kernels_sqr) kernels_sqr->batch(n,distance2,result,dfunc,invr0_2,dmax_2,stretch,shift);
+  else if(type==matheval) calculateExpressionSqr(n,distance2,result,dfunc);
+  else for(unsigned i=0;i<n;i++) result[i]=calculateSqr(distance2[i],dfunc[i]);
+}
+
+void SwitchingFunction::calculateExpressionSqr(unsigned n,const double*distance2,double*result,double*dfunc)const{
+  plumed_massert(init,"you are trying to use an unset SwitchingFunction");
+  ExpressionBuffers& buffers(expressionBuffers());
+  buffers.index.clear();
+  buffers.rdist.clear();
+// collect the distances for which the expression is needed
+  for(unsigned i=0;i<n;i++){
+    if(distance2[i]>dmax_2){
+      result[i]=0.0;
+      dfunc[i]=0.0;
+      continue;
+    }
+    const double rdist=(std::sqrt(distance2[i])-d0)*invr0;
+    if(rdist<=0.){
+      result[i]=stretch+shift;
+      dfunc[i]=0.0;
+      continue;
+    }
+    buffers.index.push_back(i);
+    buffers.rdist.push_back(rdist);
+  }
+// and evaluate it on all of them together
+  const unsigned m=buffers.index.size();
+  buffers.outputs.resize(2*m);
+  expression.evaluate(m,buffers.rdist.data(),buffers.outputs.data());
+  for(unsigned j=0;j<m;j++){
+    const unsigned i=buffers.index[j];
+    result[i]=buffers.outputs[2*j]*stretch+shift;
+    dfunc[i]=buffers.outputs[2*j+1]*invr0/std::sqrt(distance2[i])*stretch;
+  }
+}
+
 double SwitchingFunction::calculate(double distance,double&dfunc)const{
   plumed_massert(init,"you are trying to use an unset SwitchingFunction");
   if(distance>dmax){
@@ -376,7 +543,8 @@ double SwitchingFunction::calculate(double distance,double&dfunc)const{
       result=pow( 1.0 + sx, d ); 
       dfunc=-b*sx/rdist*result/(1.0+sx); 
     } else if(type==rational){
-      result=do_rational(rdist,dfunc,nn,mm);
+      if(kernels) result=kernels->scalar(rdist,dfunc);
+      else result=do_rational(rdist,dfunc,nn,mm);
     }else if(type==exponential){
       result=exp(-rdist);
       dfunc=-result;
@@ -398,8 +566,10 @@ double SwitchingFunction::calculate(double distance,double&dfunc)const{
       dfunc=-(1-tmp1*tmp1);
 #ifdef __PLUMED_HAS_MATHEVAL
     }else if(type==matheval){
-      result=evaluator_evaluate_x(evaluator,rdist);
-      dfunc=evaluator_evaluate_x(evaluator_deriv,rdist);
+      double outputs[2];
+      expression.evaluate(&rdist,outputs);
+      result=outputs[0];
+      dfunc=outputs[1];
 #endif
     }else plumed_merror("Unknown switching function type");
 // this is for the chain rule:
@@ -435,7 +605,9 @@ SwitchingFunction::SwitchingFunction():
   stretch(1.0),
   shift(0.0),
   evaluator(NULL),
-  evaluator_deriv(NULL)
+  evaluator_deriv(NULL),
+  kernels(NULL),
+  kernels_sqr(NULL)
 {
 }
 
@@ -459,7 +631,10 @@ SwitchingFunction::SwitchingFunction(const SwitchingFunction&sf):
   stretch(sf.stretch),
   shift(sf.shift),
   evaluator(NULL),
-  evaluator_deriv(NULL)
+  evaluator_deriv(NULL),
+  expression(sf.expression),
+  kernels(sf.kernels),
+  kernels_sqr(sf.kernels_sqr)
 {
 #ifdef __PLUMED_HAS_MATHEVAL
   if(sf.evaluator) evaluator=evaluator_create(evaluator_get_string(sf.evaluator));
@@ -478,6 +653,7 @@ void SwitchingFunction::set(int nn,int mm,double r0,double d0){
   this->d0=d0;
   this->dmax=d0+r0*pow(0.00001,1./(nn-mm));
   this->dmax_2=this->dmax*this->dmax;
+  setKernels();
 }
 
 double SwitchingFunction::get_r0() const {
@@ -22,6 +22,7 @@
 #ifndef __PLUMED_tools_SwitchingFunction_h
 #define __PLUMED_tools_SwitchingFunction_h
 
+#include "CompiledExpression.h"
 #include <string>
 
 namespace PLMD {
@@ -38,6 +39,10 @@ class Keywords;
 /// of a square root in some case, thus potentially increasing
 /// performances.
 class SwitchingFunction{
+public:
+/// Specialized implementations of rational functions (defined in SwitchingFunction.cpp)
+  struct Kernels;
+private:
 /// This is to check that switching function has been initialized
   bool init;
 /// Type of function
@@ -69,6 +74,19 @@ class SwitchingFunction{
   void* evaluator;
 /// Evaluator for matheval:
   void* evaluator_deriv;
+/// The matheval function and its derivative, compiled together
+  CompiledExpression expression;
+/// Specialized rational function with the exponents fixed at compile time, used by calculate().
+/// It is NULL if the switching function is not rational or if (nn,mm) is not a precompiled pair
+  const Kernels* kernels;
+/// Same as kernels, but with exponents nn/2 and mm/2, used by calculateSqr()
+/// when the square root can be avoided
+  const Kernels* kernels_sqr;
+/// Select the specialized kernels. Called once when the switching function is set
+  void setKernels();
+/// Compute a matheval switching function on an array of squared distances, evaluating
+/// the compiled expression on all the distances that are between d0 and dmax at once
+  void calculateExpressionSqr(unsigned n,const double*distance2,double*result,double*dfunc)const;
 public:
   static void registerKeywords( Keywords& keys );
 /// Constructor
@@ -98,6 +116,10 @@ public:
 /// The advantage is that in some case the expensive square root can be avoided
 /// (namely for rational functions, if nn and mm are even and d0 is zero)
   double calculateSqr(double distance2,double&dfunc)const;
+/// Compute the switching function on n squared distances.
+/// Same as calling calculateSqr() on each of them, but the choice of the
+/// function is done only once for the whole array
+  void calculateSqr(unsigned n,const double*distance2,double*result,double*dfunc)const;
 /// Returns d0
   double get_d0() const;
 /// Returns r0
@@ -70,6 +70,7 @@ class COM:
   public ActionWithVirtualAtom
 {
   bool nopbc;
+  std::vector<Tensor> deriv;
 public:
   explicit COM(const ActionOptions&ao);
   void calculate();
@@ -107,17 +108,18 @@ COM::COM(const ActionOptions&ao):
 void COM::calculate(){
   Vector pos;
   if(!nopbc) makeWhole();
+  const unsigned natoms=getNumberOfAtoms();
+  deriv.resize(natoms);
   double mass(0.0);
-  vector<Tensor> deriv(getNumberOfAtoms());
-  for(unsigned i=0;i<getNumberOfAtoms();i++) mass+=getMass(i);
+  for(unsigned i=0;i<natoms;i++) mass+=getMass(i);
   if( plumed.getAtoms().chargesWereSet() ){
      double charge(0.0);
-     for(unsigned i=0;i<getNumberOfAtoms();i++) charge+=getCharge(i);
+     for(unsigned i=0;i<natoms;i++) charge+=getCharge(i);
      setCharge(charge);
   } else {
      setCharge(0.0);
   }
-  for(unsigned i=0;i<getNumberOfAtoms();i++){
+  for(unsigned i=0;i<natoms;i++){
     pos+=(getMass(i)/mass)*getPosition(i);
     deriv[i]=(getMass(i)/mass)*Tensor::identity();
   }
@@ -80,6 +80,7 @@ class Center:
   std::vector<double> weights;
   bool weight_mass;
   bool nopbc;
+  std::vector<Tensor> deriv;
 public:
   explicit Center(const ActionOptions&ao);
   void calculate();
@@ -135,18 +136,19 @@ void Center::calculate(){
   Vector pos;
   double mass(0.0);
   if(!nopbc) makeWhole();
-  vector<Tensor> deriv(getNumberOfAtoms());
-  for(unsigned i=0;i<getNumberOfAtoms();i++) mass+=getMass(i);
+  const unsigned natoms=getNumberOfAtoms();
+  deriv.resize(natoms);
+  for(unsigned i=0;i<natoms;i++) mass+=getMass(i);
   if( plumed.getAtoms().chargesWereSet() ){
      double charge(0.0);
-     for(unsigned i=0;i<getNumberOfAtoms();i++) charge+=getCharge(i);
+     for(unsigned i=0;i<natoms;i++) charge+=getCharge(i);
      setCharge(charge);
   } else {
      setCharge(0.0);
   }
   double wtot=0.0;
   for(unsigned i=0;i<weights.size();i++) wtot+=weights[i];
-  for(unsigned i=0;i<getNumberOfAtoms();i++){
+  for(unsigned i=0;i<natoms;i++){
     double w=0;
     if(weight_mass) w=getMass(i)/mass;
     else w=weights[i]/wtot;
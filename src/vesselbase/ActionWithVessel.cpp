@@ -35,6 +35,61 @@ using namespace std;
 namespace PLMD{
 namespace vesselbase{
 
+namespace {
+
+/// Store the nonzero parts of buffer as a list of runs.
+/// Each run is stored as its starting index, its length and its elements.
+/// Runs separated by less than three zeros are merged, since storing a new run costs two elements
+template<class T>
+void compressBuffer( const std::vector<T>& buffer, std::vector<T>& compressed ){
+  compressed.resize(0);
+  const unsigned n=buffer.size();
+  unsigned i=0;
+  while(i<n){
+    if(buffer[i]==T(0)){ i++; continue; }
+    unsigned end=i+1;
+    for(unsigned j=i+1;j<n && j<end+3;++j) if(buffer[j]!=T(0)) end=j+1;
+    compressed.push_back(T(i));
+    compressed.push_back(T(end-i));
+    compressed.insert( compressed.end(), buffer.begin()+i, buffer.begin()+end );
+    i=end;
+  }
+}
+
+/// Sum buffer over all the processes in comm.
+/// Each process only sends the nonzero parts of its buffer. If all together these are more than
+/// half of the buffer, a normal reduction of the full buffer is used instead.
+/// The contributions of the processes are added in order of rank, so that the result
+/// is identical on all the processes
+template<class T>
+void sparseSum( Communicator& comm, std::vector<T>& buffer ){
+  const unsigned size=comm.Get_size();
+  if( size==1 || buffer.size()==0 ) return;
+  std::vector<T> compressed;
+  compressBuffer( buffer, compressed );
+  std::vector<int> counts( size ), displs( size );
+  int mycount=compressed.size();
+  comm.Allgather( mycount, counts );
+  unsigned total=0;
+  for(unsigned i=0;i<size;++i){ displs[i]=total; total+=counts[i]; }
+  if( 2*total>=buffer.size() ){ comm.Sum( buffer ); return; }
+  if( total==0 ) return;
+  std::vector<T> all( total );
+  // a NULL send buffer would be interpreted as MPI_IN_PLACE
+  T empty(0);
+  comm.Allgatherv( (mycount>0 ? &compressed[0] : &empty), mycount, &all[0], &counts[0], &displs[0] );
+  buffer.assign( buffer.size(), T(0) );
+  unsigned k=0;
+  while(k<total){
+    const unsigned start=all[k], length=all[k+1];
+    k+=2;
+    for(unsigned j=0;j<length;++j) buffer[start+j]+=all[k+j];
+    k+=length;
+  }
+}
+
+}
+
 void ActionWithVessel::registerKeywords(Keywords& keys){
   keys.add("hidden","TOL","this keyword can be used to speed up your calculation. When accumulating sums in which the individual "
                           "terms are numbers inbetween zero and one it is assumed that terms less than a certain tolerance "
@@ -281,12 +336,15 @@ void ActionWithVessel::runAllTasks(){
   // std::vector<double> buffer( bufsize, 0.0 );
 
   if(timers) stopwatch.start("2 Loop over tasks");
+  prepareTaskValues( nt );
+  if( nt>1 && omp_buffers.size()<nt ) omp_buffers.resize( nt );
 #pragma omp parallel num_threads(nt)
 {
-  std::vector<double> omp_buffer;
-  if( nt>1 ) omp_buffer.resize( bufsize, 0.0 );
-  MultiValue myvals( getNumberOfQuantities(), getNumberOfDerivatives() );
-  MultiValue bvals( getNumberOfQuantities(), getNumberOfDerivatives() );
+  const unsigned tid=OpenMP::getThreadNum();
+  std::vector<double>& omp_buffer( nt>1 ? omp_buffers[tid] : buffer );
+  if( nt>1 ) omp_buffer.assign( bufsize, 0.0 );
+  MultiValue& myvals( taskvals[2*tid] );
+  MultiValue& bvals( taskvals[2*tid+1] );
   myvals.clearAll(); bvals.clearAll();
  
 #pragma omp for nowait
@@ -324,10 +382,12 @@ void ActionWithVessel::runAllTasks(){
 
   if(timers) stopwatch.start("3 MPI gather");
   // MPI Gather everything
-  if( !serial && buffer.size()>0 ) comm.Sum( buffer );
+  // Only the nonzero parts of the buffer are sent, as each process only touches the
+  // elements of its own tasks
+  if( !serial && buffer.size()>0 ) sparseSum( comm, buffer );
   // MPI Gather index stores
   if( mydata && !lowmem && !noderiv ){ 
-     comm.Sum( der_list ); mydata->setActiveValsAndDerivatives( der_list ); 
+     sparseSum( comm, der_list ); mydata->setActiveValsAndDerivatives( der_list ); 
   }
   // Update the elements that are makign contributions to the sum here
   // this causes problems if we do it in prepare
@@ -338,6 +398,14 @@ void ActionWithVessel::runAllTasks(){
   if(timers) stopwatch.stop("4 Finishing computations");
 }
 
+void ActionWithVessel::prepareTaskValues( const unsigned& nt ){
+  const unsigned nquants=getNumberOfQuantities(), nder=getNumberOfDerivatives();
+  for(unsigned i=0;i<taskvals.size();++i){
+    if( taskvals[i].getNumberOfValues()!=nquants || taskvals[i].getNumberOfDerivatives()!=nder ) taskvals[i]=MultiValue( nquants, nder );
+  }
+  if( taskvals.size()<2*nt ) taskvals.resize( 2*nt, MultiValue( nquants, nder ) );
+}
+
 void ActionWithVessel::transformBridgedDerivatives( const unsigned& current, MultiValue& invals, MultiValue& outvals ) const {
   plumed_error();
 }
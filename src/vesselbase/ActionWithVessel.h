@@ -84,6 +84,14 @@ private:
   std::vector<unsigned> der_list;
 /// The buffer that we use (we keep a copy here to avoid resizing)
   std::vector<double> buffer;
+/// The buffers used by each thread in runAllTasks (kept here to avoid resizing)
+  std::vector<std::vector<double> > omp_buffers;
+/// The MultiValue objects used by each thread in runAllTasks.
+/// They are kept from one step to the next and only reallocated when the number
+/// of quantities or derivatives changes
+  std::vector<MultiValue> taskvals;
+/// Make sure there are scratch MultiValue objects for nt threads
+  void prepareTaskValues( const unsigned& nt );
 /// Do we want to output information on the timings of different parts of the calculation
   bool timers;
 /// The stopwatch that times the different parts of the calculation